@@ -0,0 +1,339 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <jsapi.h>
+
+#include <js/CompilationAndEvaluation.h>
+#include <js/Conversions.h>
+#include <js/SourceText.h>
+#include <js/ValueArray.h>
+
+#include "boilerplate.h"
+
+// Microbenchmarks for the hot JSAPI operations the other examples
+// demonstrate: property access, native call dispatch, object construction,
+// rooting, and compile+evaluate throughput. Each benchmark runs a warmup
+// phase (so the engine's caches and JITs settle) followed by a timed phase,
+// and reports nanoseconds per operation.
+//
+// Usage: bench [--json] [--iterations N] [--warmup N] [--pooled]
+//
+// --json emits machine-readable output for tracking regressions across
+// SpiderMonkey upgrades; the default is a human-readable table. --pooled
+// runs the suite on a context checked out of the boilerplate context pool
+// instead of a freshly-initialized context, and adds a benchmark of the
+// checkout + fresh-global cycle itself.
+
+struct BenchOptions {
+  unsigned iterations = 200000;
+  unsigned warmup = 10000;
+  bool json = false;
+  bool pooled = false;
+};
+static BenchOptions benchOptions;
+
+struct BenchResult {
+  std::string name;
+  double nsPerOp;
+  unsigned iterations;
+};
+static std::vector<BenchResult> benchResults;
+
+class Timer {
+  std::chrono::steady_clock::time_point m_start;
+
+ public:
+  Timer(void) : m_start(std::chrono::steady_clock::now()) {}
+
+  double ElapsedNs(void) const {
+    auto elapsed = std::chrono::steady_clock::now() - m_start;
+    return double(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+  }
+};
+
+static void Record(const char* name, double elapsedNs, unsigned iterations) {
+  benchResults.push_back({name, elapsedNs / iterations, iterations});
+}
+
+/**** BENCHMARKS **************************************************************/
+
+// Property get/set through JS_GetProperty/JS_SetProperty, the pattern from
+// cookbook.cpp's GetProperty/SetProperty helpers.
+static bool BenchPropertyAccess(JSContext* cx, JS::HandleObject obj) {
+  JS::RootedValue v(cx, JS::Int32Value(42));
+  if (!JS_SetProperty(cx, obj, "myprop", v)) return false;
+
+  for (unsigned i = 0; i < benchOptions.warmup; i++) {
+    if (!JS_GetProperty(cx, obj, "myprop", &v)) return false;
+  }
+  {
+    Timer timer;
+    for (unsigned i = 0; i < benchOptions.iterations; i++) {
+      if (!JS_GetProperty(cx, obj, "myprop", &v)) return false;
+    }
+    Record("property_get", timer.ElapsedNs(), benchOptions.iterations);
+  }
+
+  for (unsigned i = 0; i < benchOptions.warmup; i++) {
+    if (!JS_SetProperty(cx, obj, "myprop", v)) return false;
+  }
+  {
+    Timer timer;
+    for (unsigned i = 0; i < benchOptions.iterations; i++) {
+      if (!JS_SetProperty(cx, obj, "myprop", v)) return false;
+    }
+    Record("property_set", timer.ElapsedNs(), benchOptions.iterations);
+  }
+
+  return true;
+}
+
+// Call dispatch from C++ into a global JS function, as in cookbook.cpp's
+// CallGlobalFunction.
+static bool BenchGlobalCall(JSContext* cx, JS::HandleObject global) {
+  JS::RootedValue r(cx);
+
+  for (unsigned i = 0; i < benchOptions.warmup; i++) {
+    if (!JS_CallFunctionName(cx, global, "foo", JS::HandleValueArray::empty(),
+                             &r))
+      return false;
+  }
+
+  Timer timer;
+  for (unsigned i = 0; i < benchOptions.iterations; i++) {
+    if (!JS_CallFunctionName(cx, global, "foo", JS::HandleValueArray::empty(),
+                             &r))
+      return false;
+  }
+  Record("global_call", timer.ElapsedNs(), benchOptions.iterations);
+  return true;
+}
+
+// Object construction through JS::Construct, as in cookbook.cpp's
+// ConstructObjectWithNew.
+static bool BenchConstruct(JSContext* cx, JS::HandleObject global) {
+  JS::RootedValue constructor(cx);
+  if (!JS_GetProperty(cx, global, "Person", &constructor)) return false;
+
+  JS::RootedString name(cx, JS_NewStringCopyZ(cx, "Dave"));
+  if (!name) return false;
+
+  JS::RootedValueArray<2> args(cx);
+  args[0].setString(name);
+  args[1].setInt32(24);
+
+  JS::RootedObject obj(cx);
+  for (unsigned i = 0; i < benchOptions.warmup; i++) {
+    if (!JS::Construct(cx, constructor, args, &obj)) return false;
+  }
+
+  Timer timer;
+  for (unsigned i = 0; i < benchOptions.iterations; i++) {
+    if (!JS::Construct(cx, constructor, args, &obj)) return false;
+  }
+  Record("construct", timer.ElapsedNs(), benchOptions.iterations);
+  return true;
+}
+
+// Rooting overhead: pushing/popping a stack root, and registering/
+// unregistering a PersistentRooted, which tracing.cpp warns is the expensive
+// pattern when done rapidly.
+static bool BenchRooting(JSContext* cx) {
+  {
+    Timer timer;
+    for (unsigned i = 0; i < benchOptions.iterations; i++) {
+      JS::RootedValue v(cx, JS::Int32Value(int32_t(i)));
+      (void)v;
+    }
+    Record("rooted_push_pop", timer.ElapsedNs(), benchOptions.iterations);
+  }
+
+  {
+    Timer timer;
+    for (unsigned i = 0; i < benchOptions.iterations; i++) {
+      JS::PersistentRootedValue v(cx, JS::Int32Value(int32_t(i)));
+      (void)v;
+    }
+    Record("persistent_rooted_create_destroy", timer.ElapsedNs(),
+           benchOptions.iterations);
+  }
+
+  return true;
+}
+
+// Compile+evaluate throughput of a small snippet, as in cookbook.cpp's
+// ExecuteCode. Compilation dominates here; compare with a cached script to
+// see what recompiling costs.
+static bool BenchCompileEvaluate(JSContext* cx) {
+  static const char* code = "1 + 2 * 3";
+
+  // Far fewer iterations: each one is a full parse.
+  unsigned iterations = benchOptions.iterations / 100 + 1;
+
+  JS::RootedValue result(cx);
+  for (unsigned i = 0; i < benchOptions.warmup / 100 + 1; i++) {
+    JS::CompileOptions options(cx);
+    options.setFileAndLine("bench", 1);
+    JS::SourceText<mozilla::Utf8Unit> source;
+    if (!source.init(cx, code, strlen(code), JS::SourceOwnership::Borrowed))
+      return false;
+    if (!JS::Evaluate(cx, options, source, &result)) return false;
+  }
+
+  Timer timer;
+  for (unsigned i = 0; i < iterations; i++) {
+    JS::CompileOptions options(cx);
+    options.setFileAndLine("bench", 1);
+    JS::SourceText<mozilla::Utf8Unit> source;
+    if (!source.init(cx, code, strlen(code), JS::SourceOwnership::Borrowed))
+      return false;
+    if (!JS::Evaluate(cx, options, source, &result)) return false;
+  }
+  Record("compile_evaluate", timer.ElapsedNs(), iterations);
+  return true;
+}
+
+// The context pool's pitch is that a "run" costs a checkout plus a fresh
+// global instead of JS_NewContext + InitSelfHostedCode; this measures that
+// cycle. Only meaningful under --pooled, after InitContextPool.
+static bool BenchPooledCheckout(void) {
+  // Each iteration is a whole realm creation; far fewer than the default.
+  unsigned iterations = benchOptions.iterations / 200 + 1;
+
+  Timer timer;
+  for (unsigned i = 0; i < iterations; i++) {
+    boilerplate::AutoPooledContext pooled;
+    if (!pooled) return false;
+
+    JS::RootedObject global(pooled.get(),
+                            boilerplate::CreateGlobal(pooled.get()));
+    if (!global) return false;
+  }
+  Record("pooled_checkout_realm", timer.ElapsedNs(), iterations);
+  return true;
+}
+
+/**** HARNESS *****************************************************************/
+
+static bool PersonConstructor(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  JS::RootedObject newObject(cx, JS_NewPlainObject(cx));
+  if (!newObject) return false;
+  args.rval().setObject(*newObject);
+  return true;
+}
+
+static bool Nop(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  args.rval().setUndefined();
+  return true;
+}
+
+static JSFunctionSpec benchFunctions[] = {
+    JS_FN("foo", Nop, 0, 0),
+    JS_FN("Person", PersonConstructor, 2, JSFUN_CONSTRUCTOR), JS_FS_END};
+
+static void PrintResults(void) {
+  boilerplate::GCStats gc = boilerplate::GetGCStats();
+  double avgMinorMs =
+      gc.minorCollections ? gc.totalMinorPauseMs / gc.minorCollections : 0;
+
+  if (benchOptions.json) {
+    std::cout << "{\"benchmarks\":[";
+    for (size_t i = 0; i < benchResults.size(); i++) {
+      const BenchResult& result = benchResults[i];
+      if (i > 0) std::cout << ',';
+      std::cout << "{\"name\":\"" << result.name << "\",\"ns_per_op\":"
+                << result.nsPerOp << ",\"iterations\":" << result.iterations
+                << '}';
+    }
+    std::cout << "],\"gc\":{\"major\":" << gc.majorCollections
+              << ",\"minor\":" << gc.minorCollections
+              << ",\"slices\":" << gc.slices
+              << ",\"max_slice_pause_ms\":" << gc.maxSlicePauseMs
+              << ",\"avg_minor_pause_ms\":" << avgMinorMs
+              << ",\"promoted_bytes_estimate\":" << gc.promotedBytesEstimate
+              << "}}\n";
+    return;
+  }
+
+  for (const BenchResult& result : benchResults) {
+    printf("%-36s %10.1f ns/op  (%u iterations)\n", result.name.c_str(),
+           result.nsPerOp, result.iterations);
+  }
+
+  printf("gc: %llu major, %llu minor (avg pause %.3f ms), "
+         "%llu slices (max %.3f ms), ~%llu bytes promoted\n",
+         (unsigned long long)gc.majorCollections,
+         (unsigned long long)gc.minorCollections, avgMinorMs,
+         (unsigned long long)gc.slices, gc.maxSlicePauseMs,
+         (unsigned long long)gc.promotedBytesEstimate);
+}
+
+static bool RunBenchmarks(JSContext* cx) {
+  // Bound incremental slice pauses and watch what the suite does to the
+  // collector; the accumulated numbers print after the results table.
+  boilerplate::GCConfig gcConfig;
+  gcConfig.sliceTimeBudgetMs = 5;
+  boilerplate::ApplyGCConfig(cx, gcConfig);
+  boilerplate::AttachGCTelemetry(cx);
+
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+
+  JSAutoRealm ar(cx, global);
+
+  if (!JS_DefineFunctions(cx, global, benchFunctions)) return false;
+
+  JS::RootedObject obj(cx, JS_NewPlainObject(cx));
+  if (!obj) return false;
+
+  if (!BenchPropertyAccess(cx, obj) || !BenchGlobalCall(cx, global) ||
+      !BenchConstruct(cx, global) || !BenchRooting(cx) ||
+      !BenchCompileEvaluate(cx)) {
+    boilerplate::ReportAndClearException(cx);
+    return false;
+  }
+
+  PrintResults();
+  return true;
+}
+
+int main(int argc, const char* argv[]) {
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--json")) {
+      benchOptions.json = true;
+    } else if (!strcmp(argv[i], "--iterations") && i + 1 < argc) {
+      benchOptions.iterations = unsigned(atoi(argv[++i]));
+    } else if (!strcmp(argv[i], "--warmup") && i + 1 < argc) {
+      benchOptions.warmup = unsigned(atoi(argv[++i]));
+    } else if (!strcmp(argv[i], "--pooled")) {
+      benchOptions.pooled = true;
+    } else {
+      std::cerr
+          << "usage: bench [--json] [--iterations N] [--warmup N] [--pooled]\n";
+      return 1;
+    }
+  }
+
+  if (benchOptions.pooled) {
+    // The pool brackets JS_Init/JS_ShutDown itself, so this replaces
+    // RunExample rather than nesting inside it. Two contexts, so the
+    // checkout benchmark recycles between them rather than always getting
+    // the same warm one back.
+    if (!boilerplate::InitContextPool(2)) return 1;
+
+    bool ok = BenchPooledCheckout() &&
+              boilerplate::RunPooledExample(RunBenchmarks);
+    boilerplate::ShutdownContextPool();
+    return ok ? 0 : 1;
+  }
+
+  if (!boilerplate::RunExample(RunBenchmarks)) return 1;
+  return 0;
+}
@@ -1,24 +1,97 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <jsapi.h>
 
+#include <js/CompilationAndEvaluation.h>
+#include <js/GCAPI.h>
 #include <js/Initialization.h>
+#include <js/SourceText.h>
 
 #include "boilerplate.h"
 
 // This file contains boilerplate code used by a number of examples. Ideally
 // this should eventually become part of SpiderMonkey itself.
 
+static JSClass BoilerplateGlobalClass = {
+    "BoilerplateGlobal", JSCLASS_GLOBAL_FLAGS, &JS::DefaultGlobalClassOps};
+
 // Create a simple Global object. A global object is the top-level 'this' value
 // in a script and is required in order to compile or execute JavaScript.
 JSObject* boilerplate::CreateGlobal(JSContext* cx) {
   JS::RealmOptions options;
 
-  static JSClass BoilerplateGlobalClass = {
-      "BoilerplateGlobal", JSCLASS_GLOBAL_FLAGS, &JS::DefaultGlobalClassOps};
+  return JS_NewGlobalObject(cx, &BoilerplateGlobalClass, nullptr,
+                            JS::FireOnNewGlobalHook, options);
+}
+
+// Create a global in the same compartment as an existing one. Each realm is
+// still a separate JS environment (own global, own standard classes), but
+// objects in one compartment call into each other directly -- no
+// cross-compartment wrappers -- and the per-compartment memory overhead is
+// paid once for the whole group.
+JSObject* boilerplate::CreateGlobalInSharedCompartment(
+    JSContext* cx, JS::HandleObject existing) {
+  JS::RealmOptions options;
+  options.creationOptions().setExistingCompartment(existing);
 
   return JS_NewGlobalObject(cx, &BoilerplateGlobalClass, nullptr,
                             JS::FireOnNewGlobalHook, options);
 }
 
+void boilerplate::TenantRealms::Roots::trace(JSTracer* trc) {
+  for (auto& global : globals) {
+    JS::TraceEdge(trc, &global, "tenant global");
+  }
+}
+
+bool boilerplate::TenantRealms::init(JSContext* cx) {
+  m_roots.init(cx);
+  return true;
+}
+
+void boilerplate::TenantRealms::reset(void) { m_roots.reset(); }
+
+// The first tenant opens a fresh compartment; every later tenant joins it,
+// so inter-tenant calls routed by the embedding stay wrapper-free.
+JSObject* boilerplate::TenantRealms::CreateTenantGlobal(JSContext* cx) {
+  auto& globals = m_roots.get().globals;
+
+  JSObject* global;
+  if (globals.empty()) {
+    global = boilerplate::CreateGlobal(cx);
+  } else {
+    JS::RootedObject first(cx, globals.front());
+    global = CreateGlobalInSharedCompartment(cx, first);
+  }
+  if (!global) return nullptr;
+
+  globals.emplace_back(global);
+  return global;
+}
+
+size_t boilerplate::TenantRealms::Count(void) const {
+  return m_roots.get().globals.size();
+}
+
+// Drop every tenant global and shrink-GC so the compartment's memory comes
+// back in one sweep instead of a realm at a time as tenants expire.
+void boilerplate::TenantRealms::TeardownAll(JSContext* cx) {
+  m_roots.get().globals.clear();
+  JS::NonIncrementalGC(cx, GC_SHRINK, JS::GCReason::API);
+}
+
 // Helper to read current exception and dump to stderr.
 //
 // NOTE: This must be called with a JSAutoRealm (or equivalent) on the stack.
@@ -38,6 +111,1000 @@ void boilerplate::ReportAndClearException(JSContext* cx) {
   JS::PrintError(stderr, report, false);
 }
 
+static bool EvaluateUtf8(JSContext* cx, const char* path, const char* chars,
+                         size_t length, JS::MutableHandleValue result) {
+  JS::CompileOptions options(cx);
+  options.setFileAndLine(path, 1);
+
+  // Borrowed: the parser reads straight out of our buffer/mapping, no copy.
+  JS::SourceText<mozilla::Utf8Unit> source;
+  if (!source.init(cx, chars, length, JS::SourceOwnership::Borrowed)) {
+    return false;
+  }
+
+  return JS::Evaluate(cx, options, source, result);
+}
+
+// Evaluate a script file with one copy of the source in memory. There is no
+// public streaming source-compile API in this SpiderMonkey, so the I/O /
+// parse overlap comes from demand paging instead: the file is mapped rather
+// than read, MADV_SEQUENTIAL cranks up kernel readahead, and the parser
+// starts on the first page while later pages are still arriving from disk.
+bool boilerplate::EvaluateFile(JSContext* cx, const char* path,
+                               JS::MutableHandleValue result) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    JS_ReportErrorASCII(cx, "could not open %s", path);
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    JS_ReportErrorASCII(cx, "could not stat %s", path);
+    return false;
+  }
+
+  if (S_ISREG(st.st_mode) && st.st_size > 0) {
+    size_t length = size_t(st.st_size);
+    void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+      JS_ReportErrorASCII(cx, "could not map %s", path);
+      return false;
+    }
+    madvise(mapping, length, MADV_SEQUENTIAL);
+
+    bool ok = EvaluateUtf8(cx, path, static_cast<const char*>(mapping),
+                           length, result);
+    munmap(mapping, length);
+    return ok;
+  }
+
+  // Pipes and other non-mappable inputs: chunked reads into a growing
+  // buffer. No parse overlap here, but still a single resident copy.
+  std::vector<char> buffer;
+  char chunk[65536];
+  ssize_t got;
+  while ((got = read(fd, chunk, sizeof(chunk))) > 0) {
+    buffer.insert(buffer.end(), chunk, chunk + got);
+  }
+  close(fd);
+  if (got < 0) {
+    JS_ReportErrorASCII(cx, "error reading %s", path);
+    return false;
+  }
+
+  return EvaluateUtf8(cx, path, buffer.data(), buffer.size(), result);
+}
+
+// JIT tiering controls. The triggers are exposed through the JIT compiler
+// options interface; they take effect for warm-up counting from the moment
+// they are set, so setting them before the first hot execution is enough --
+// already-compiled code is not recompiled.
+void boilerplate::ConfigureJitTiering(JSContext* cx,
+                                      const JitTierConfig& config) {
+  if (config.forceFullJit) {
+    JS_SetGlobalJitCompilerOption(cx, JSJITCOMPILER_BASELINE_WARMUP_TRIGGER,
+                                  0);
+    JS_SetGlobalJitCompilerOption(cx, JSJITCOMPILER_ION_NORMAL_WARMUP_TRIGGER,
+                                  0);
+    return;
+  }
+  if (config.baselineWarmupTrigger != UINT32_MAX) {
+    JS_SetGlobalJitCompilerOption(cx, JSJITCOMPILER_BASELINE_WARMUP_TRIGGER,
+                                  config.baselineWarmupTrigger);
+  }
+  if (config.ionWarmupTrigger != UINT32_MAX) {
+    JS_SetGlobalJitCompilerOption(cx, JSJITCOMPILER_ION_NORMAL_WARMUP_TRIGGER,
+                                  config.ionWarmupTrigger);
+  }
+}
+
+void boilerplate::ConfigureJitTieringFromEnv(JSContext* cx) {
+  JitTierConfig config;
+  if (const char* trigger = getenv("JIT_BASELINE_WARMUP")) {
+    config.baselineWarmupTrigger = uint32_t(strtoul(trigger, nullptr, 10));
+  }
+  if (const char* trigger = getenv("JIT_ION_WARMUP")) {
+    config.ionWarmupTrigger = uint32_t(strtoul(trigger, nullptr, 10));
+  }
+  if (const char* force = getenv("JIT_FORCE_FULL")) {
+    config.forceFullJit = (force[0] == '1');
+  }
+  ConfigureJitTiering(cx, config);
+}
+
+boilerplate::JitTierConfig boilerplate::GetJitTierConfig(JSContext* cx) {
+  JitTierConfig config;
+  uint32_t value;
+  if (JS_GetGlobalJitCompilerOption(cx, JSJITCOMPILER_BASELINE_WARMUP_TRIGGER,
+                                    &value)) {
+    config.baselineWarmupTrigger = value;
+  }
+  if (JS_GetGlobalJitCompilerOption(
+          cx, JSJITCOMPILER_ION_NORMAL_WARMUP_TRIGGER, &value)) {
+    config.ionWarmupTrigger = value;
+  }
+  config.forceFullJit =
+      config.baselineWarmupTrigger == 0 && config.ionWarmupTrigger == 0;
+  return config;
+}
+
+const char* boilerplate::PredictedJitTier(JSContext* cx, uint64_t runCount) {
+  JitTierConfig config = GetJitTierConfig(cx);
+  if (runCount > config.ionWarmupTrigger) return "ion";
+  if (runCount > config.baselineWarmupTrigger) return "baseline";
+  return "interpreter";
+}
+
+// Fast error capture. The ring is preallocated and fixed-size: capturing an
+// error is a couple of bounded string copies under a mutex, never an
+// allocation. Entries are overwritten oldest-first when nothing drains them.
+static constexpr size_t kErrorRingSize = 64;
+
+static std::mutex errorRingLock;
+static boilerplate::CapturedError errorRing[kErrorRingSize];
+static size_t errorRingHead = 0;  // next slot to write
+static size_t errorRingCount = 0;
+static uint64_t errorRingDropped = 0;
+
+static void CopyTruncated(char* dst, size_t cap, const char* src) {
+  size_t i = 0;
+  for (; src[i] && i + 1 < cap; i++) dst[i] = src[i];
+  dst[i] = '\0';
+}
+
+bool boilerplate::CaptureError(JSContext* cx) {
+  if (!JS_IsExceptionPending(cx)) return false;
+
+  JS::RootedValue exc(cx);
+  if (!JS_GetPendingException(cx, &exc)) return false;
+  JS_ClearPendingException(cx);
+
+  CapturedError entry;
+  entry.message[0] = '\0';
+  entry.filename[0] = '\0';
+  entry.lineno = 0;
+  entry.column = 0;
+
+  // Error objects already carry a JSErrorReport with the message rendered;
+  // reading it is free. Only genuinely odd throw values miss this path.
+  JSErrorReport* report = nullptr;
+  if (exc.isObject()) {
+    JS::RootedObject obj(cx, &exc.toObject());
+    report = JS_ErrorFromException(cx, obj);
+  }
+
+  if (report) {
+    CopyTruncated(entry.message, sizeof(entry.message),
+                  report->message().c_str());
+    if (report->filename) {
+      CopyTruncated(entry.filename, sizeof(entry.filename), report->filename);
+    }
+    entry.lineno = report->lineno;
+    entry.column = report->column;
+  } else if (exc.isString()) {
+    JSLinearString* linear = JS_EnsureLinearString(cx, exc.toString());
+    if (linear && JS_LinearStringHasLatin1Chars(linear)) {
+      size_t length = JS_GetStringLength(exc.toString());
+      if (length >= sizeof(entry.message)) length = sizeof(entry.message) - 1;
+      JS::AutoCheckCannotGC nogc;
+      const JS::Latin1Char* chars = JS_GetLatin1LinearStringChars(nogc, linear);
+      memcpy(entry.message, chars, length);
+      entry.message[length] = '\0';
+    } else {
+      CopyTruncated(entry.message, sizeof(entry.message),
+                    "[non-Latin-1 exception string]");
+    }
+  } else {
+    CopyTruncated(entry.message, sizeof(entry.message),
+                  "[non-Error exception thrown]");
+  }
+
+  std::lock_guard<std::mutex> guard(errorRingLock);
+  errorRing[errorRingHead] = entry;
+  errorRingHead = (errorRingHead + 1) % kErrorRingSize;
+  if (errorRingCount < kErrorRingSize) {
+    errorRingCount++;
+  } else {
+    errorRingDropped++;  // overwrote the oldest unread entry
+  }
+  return true;
+}
+
+size_t boilerplate::TakeCapturedErrors(CapturedError* out, size_t max) {
+  std::lock_guard<std::mutex> guard(errorRingLock);
+
+  size_t taken = 0;
+  while (taken < max && errorRingCount > 0) {
+    size_t oldest = (errorRingHead + kErrorRingSize - errorRingCount) %
+                    kErrorRingSize;
+    out[taken++] = errorRing[oldest];
+    errorRingCount--;
+  }
+  return taken;
+}
+
+uint64_t boilerplate::CapturedErrorsDropped(void) {
+  std::lock_guard<std::mutex> guard(errorRingLock);
+  return errorRingDropped;
+}
+
+// Self-hosted-code snapshot. JS::InitSelfHostedCode compiles the engine's
+// self-hosted JavaScript from scratch by default -- tens of milliseconds per
+// context, repeated for every worker context and every process start. The
+// ESR91 API takes an optional XDR cache and writer: the first context in the
+// process compiles and serializes, and every later context deserializes the
+// snapshot instead. The snapshot also goes to disk (atomically, temp file
+// plus rename, like the module XDR cache) so subsequent processes skip even
+// the first compile. The in-memory snapshot is write-once: after it is
+// filled it is never reassigned, so callers can parse from it without
+// holding the lock. A snapshot that fails to deserialize -- a stale disk
+// cache from another engine build -- is retired rather than freed, because
+// sibling workers may still be reading from it; see
+// InitSelfHostedCodeCached.
+static std::mutex selfHostedLock;
+static std::vector<uint8_t> selfHostedSnapshot;
+static std::vector<std::vector<uint8_t>> retiredSnapshots;
+
+static const char* SelfHostedCachePath(void) {
+  const char* path = getenv("SELF_HOSTED_CACHE");
+  return path ? path : ".selfhosted.xdr";
+}
+
+// Called with selfHostedLock held.
+static void LoadSelfHostedSnapshot(void) {
+  FILE* file = fopen(SelfHostedCachePath(), "rb");
+  if (!file) return;
+
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  if (size > 0) {
+    selfHostedSnapshot.resize(size_t(size));
+    if (fread(selfHostedSnapshot.data(), 1, size_t(size), file) !=
+        size_t(size)) {
+      selfHostedSnapshot.clear();
+    }
+  }
+  fclose(file);
+}
+
+static bool WriteSelfHostedSnapshot(JSContext* cx, JS::SelfHostedCache data) {
+  std::lock_guard<std::mutex> guard(selfHostedLock);
+  if (!selfHostedSnapshot.empty()) return true;  // another context won
+
+  selfHostedSnapshot.assign(data.data(), data.data() + data.size());
+
+  std::string tmpPath = std::string(SelfHostedCachePath()) + ".tmp";
+  FILE* file = fopen(tmpPath.c_str(), "wb");
+  if (!file) return true;  // disk cache is best-effort
+  bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+  fclose(file);
+  if (written) {
+    rename(tmpPath.c_str(), SelfHostedCachePath());
+  } else {
+    remove(tmpPath.c_str());
+  }
+  return true;
+}
+
+bool boilerplate::InitSelfHostedCodeCached(JSContext* cx) {
+  const uint8_t* cached = nullptr;
+  size_t cachedSize = 0;
+  {
+    std::lock_guard<std::mutex> guard(selfHostedLock);
+    static bool diskChecked = false;
+    if (!diskChecked) {
+      LoadSelfHostedSnapshot();
+      diskChecked = true;
+    }
+    if (!selfHostedSnapshot.empty()) {
+      cached = selfHostedSnapshot.data();
+      cachedSize = selfHostedSnapshot.size();
+    }
+  }
+
+  if (cached) {
+    if (JS::InitSelfHostedCode(cx, JS::SelfHostedCache(cached, cachedSize),
+                               nullptr)) {
+      return true;
+    }
+
+    // A snapshot that no longer deserializes -- XDR is build-dependent, so
+    // any libmozjs upgrade stales the disk cache -- must not be fatal: drop
+    // it everywhere and fall through to a fresh compile, which also rewrites
+    // the disk cache for the new build. Concurrently-starting workers all
+    // hit this path with raw pointers into the same buffer, so the buffer
+    // must stay alive: move it onto the retired list (at most once per
+    // stale cache) instead of freeing it under their feet.
+    JS_ClearPendingException(cx);
+    {
+      std::lock_guard<std::mutex> guard(selfHostedLock);
+      retiredSnapshots.push_back(std::move(selfHostedSnapshot));
+      selfHostedSnapshot.clear();
+    }
+    remove(SelfHostedCachePath());
+  }
+
+  // No (usable) snapshot: compile, and serialize through the writer for
+  // everyone after us.
+  return JS::InitSelfHostedCode(cx, nullptr, WriteSelfHostedSnapshot);
+}
+
+// A pool of pre-warmed contexts. Creating a JSContext and especially running
+// JS::InitSelfHostedCode is the dominant fixed cost of a RunExample-style
+// setup, so embeddings that run many short tasks should pay it once per
+// context and recycle. Checked-in contexts keep their self-hosted state; a
+// task gets isolation by creating a fresh global (realm) in the borrowed
+// context, which is orders of magnitude cheaper.
+//
+// NOTE: A JSContext may only be used on the thread that created it, so the
+// pool must be initialized, used, and shut down on one thread (or one pool
+// kept per thread). See RunParallel-style designs for multi-thread use.
+static std::mutex poolLock;
+static std::vector<JSContext*> allContexts;
+static std::vector<JSContext*> idleContexts;
+
+bool boilerplate::InitContextPool(unsigned poolSize) {
+  if (!JS_Init()) {
+    return false;
+  }
+
+  for (unsigned i = 0; i < poolSize; i++) {
+    JSContext* cx = JS_NewContext(JS::DefaultHeapMaxBytes);
+    if (!cx || !InitSelfHostedCodeCached(cx)) {
+      if (cx) JS_DestroyContext(cx);
+      ShutdownContextPool();
+      return false;
+    }
+    ConfigureJitTieringFromEnv(cx);
+    allContexts.push_back(cx);
+    idleContexts.push_back(cx);
+  }
+
+  return true;
+}
+
+void boilerplate::ShutdownContextPool(void) {
+  for (JSContext* cx : allContexts) {
+    JS_DestroyContext(cx);
+  }
+  allContexts.clear();
+  idleContexts.clear();
+  JS_ShutDown();
+}
+
+JSContext* boilerplate::CheckoutContext(void) {
+  std::lock_guard<std::mutex> guard(poolLock);
+  if (idleContexts.empty()) {
+    return nullptr;
+  }
+  JSContext* cx = idleContexts.back();
+  idleContexts.pop_back();
+  return cx;
+}
+
+void boilerplate::CheckinContext(JSContext* cx) {
+  // Give the GC a chance to collect the realms the task created before the
+  // context goes back on the shelf.
+  JS_MaybeGC(cx);
+
+  std::lock_guard<std::mutex> guard(poolLock);
+  idleContexts.push_back(cx);
+}
+
+bool boilerplate::RunPooledExample(bool (*task)(JSContext*)) {
+  AutoPooledContext cx;
+  if (!cx) {
+    return false;
+  }
+  return task(cx.get());
+}
+
+// Class-registration cache. RegisterClass pins each property-name atom once
+// (a pinned atom is a GC root for the life of the runtime, so the raw jsid
+// can be stored without further rooting -- the same guarantee
+// JS::PropertyKey::fromPinnedString relies on) and InstallClasses replays the
+// definitions through the ById entry points, skipping the spec parsing and
+// atomization JS_InitClass does on every call.
+namespace {
+
+struct InternedFunction {
+  jsid id;
+  JSNative native;
+  uint16_t nargs;
+};
+
+struct InternedGetter {
+  jsid id;
+  JSNative getter;
+};
+
+struct RegisteredClass {
+  const JSClass* clasp;
+  JSNative constructor;
+  unsigned ctorNargs;
+  jsid ctorId;
+  std::vector<InternedFunction> methods;
+  std::vector<InternedGetter> properties;
+  std::vector<InternedFunction> staticMethods;
+  std::vector<InternedGetter> staticProperties;
+};
+
+std::vector<RegisteredClass> classRegistry;
+
+bool InternPinnedId(JSContext* cx, const char* name, jsid* out) {
+  JSString* atom = JS_AtomizeAndPinString(cx, name);
+  if (!atom) return false;
+  *out = JS::PropertyKey::fromPinnedString(atom);
+  return true;
+}
+
+bool DefineInterned(JSContext* cx, JS::HandleObject target,
+                    const std::vector<InternedFunction>& methods,
+                    const std::vector<InternedGetter>& getters) {
+  JS::RootedId id(cx);
+  for (const InternedFunction& method : methods) {
+    id = method.id;
+    if (!JS_DefineFunctionById(cx, target, id, method.native, method.nargs,
+                               JSPROP_ENUMERATE))
+      return false;
+  }
+  for (const InternedGetter& getter : getters) {
+    id = getter.id;
+    if (!JS_DefinePropertyById(cx, target, id, getter.getter, nullptr,
+                               JSPROP_ENUMERATE))
+      return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+bool boilerplate::RegisterClass(JSContext* cx, const ClassSpec& spec) {
+  RegisteredClass rc;
+  rc.clasp = spec.clasp;
+  rc.constructor = spec.constructor;
+  rc.ctorNargs = spec.ctorNargs;
+  if (!InternPinnedId(cx, spec.clasp->name, &rc.ctorId)) return false;
+
+  for (const ClassMethod* m = spec.methods; m && m->name; m++) {
+    InternedFunction f{JSID_VOID, m->native, m->nargs};
+    if (!InternPinnedId(cx, m->name, &f.id)) return false;
+    rc.methods.push_back(f);
+  }
+  for (const ClassGetter* g = spec.properties; g && g->name; g++) {
+    InternedGetter p{JSID_VOID, g->getter};
+    if (!InternPinnedId(cx, g->name, &p.id)) return false;
+    rc.properties.push_back(p);
+  }
+  for (const ClassMethod* m = spec.staticMethods; m && m->name; m++) {
+    InternedFunction f{JSID_VOID, m->native, m->nargs};
+    if (!InternPinnedId(cx, m->name, &f.id)) return false;
+    rc.staticMethods.push_back(f);
+  }
+  for (const ClassGetter* g = spec.staticProperties; g && g->name; g++) {
+    InternedGetter p{JSID_VOID, g->getter};
+    if (!InternPinnedId(cx, g->name, &p.id)) return false;
+    rc.staticProperties.push_back(p);
+  }
+
+  classRegistry.push_back(std::move(rc));
+  return true;
+}
+
+bool boilerplate::InstallClasses(JSContext* cx, JS::HandleObject global) {
+  for (const RegisteredClass& rc : classRegistry) {
+    JS::RootedObject proto(cx, JS_NewObject(cx, rc.clasp));
+    if (!proto) return false;
+
+    JSFunction* ctorFun = JS_NewFunction(cx, rc.constructor, rc.ctorNargs,
+                                         JSFUN_CONSTRUCTOR, rc.clasp->name);
+    if (!ctorFun) return false;
+    JS::RootedObject ctor(cx, JS_GetFunctionObject(ctorFun));
+
+    if (!JS_LinkConstructorAndPrototype(cx, ctor, proto)) return false;
+
+    if (!DefineInterned(cx, proto, rc.methods, rc.properties)) return false;
+    if (!DefineInterned(cx, ctor, rc.staticMethods, rc.staticProperties))
+      return false;
+
+    JS::RootedId ctorId(cx, rc.ctorId);
+    if (!JS_DefinePropertyById(cx, global, ctorId, ctor, 0)) return false;
+  }
+  return true;
+}
+
+// Multi-threaded harness. SpiderMonkey supports one JSContext per thread;
+// JS_Init/JS_ShutDown however are process-wide and must bracket all context
+// use, so they run exactly once here on the spawning thread. Each worker
+// creates (and destroys) its context on its own thread -- contexts may not
+// migrate between threads.
+bool boilerplate::RunParallel(bool (*task)(JSContext*), unsigned nThreads) {
+  if (!JS_Init()) {
+    return false;
+  }
+
+  std::atomic<bool> ok(true);
+  std::vector<std::thread> threads;
+  threads.reserve(nThreads);
+
+  for (unsigned i = 0; i < nThreads; i++) {
+    threads.emplace_back([task, &ok] {
+      JSContext* cx = JS_NewContext(JS::DefaultHeapMaxBytes);
+      if (!cx) {
+        ok = false;
+        return;
+      }
+      ConfigureJitTieringFromEnv(cx);
+      if (!InitSelfHostedCodeCached(cx) || !task(cx)) {
+        ok = false;
+      }
+      JS_DestroyContext(cx);
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  JS_ShutDown();
+  return ok;
+}
+
+// Shared job queue drained by RunParallelJobs workers. Only the queue index
+// is shared; every job runs against the executing thread's own global.
+namespace {
+struct ScriptJobQueue {
+  const std::vector<std::string>* scripts;
+  std::atomic<size_t> next{0};
+  std::atomic<bool> ok{true};
+};
+ScriptJobQueue* currentJobQueue = nullptr;
+}  // namespace
+
+static bool DrainScriptJobs(JSContext* cx) {
+  ScriptJobQueue* queue = currentJobQueue;
+
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) {
+    return false;
+  }
+  JSAutoRealm ar(cx, global);
+
+  for (;;) {
+    size_t index = queue->next.fetch_add(1);
+    if (index >= queue->scripts->size()) {
+      return true;
+    }
+    const std::string& code = (*queue->scripts)[index];
+
+    JS::CompileOptions options(cx);
+    options.setFileAndLine("job", 1);
+
+    JS::SourceText<mozilla::Utf8Unit> source;
+    if (!source.init(cx, code.c_str(), code.size(),
+                     JS::SourceOwnership::Borrowed)) {
+      return false;
+    }
+
+    JS::RootedValue result(cx);
+    if (!JS::Evaluate(cx, options, source, &result)) {
+      boilerplate::ReportAndClearException(cx);
+      queue->ok = false;
+    }
+  }
+}
+
+bool boilerplate::RunParallelJobs(const std::vector<std::string>& scripts,
+                                  unsigned nThreads) {
+  ScriptJobQueue queue;
+  queue.scripts = &scripts;
+  currentJobQueue = &queue;
+
+  bool ran = RunParallel(DrainScriptJobs, nThreads);
+  currentJobQueue = nullptr;
+  return ran && queue.ok;
+}
+
+// Transfer channel between contexts. Structured clone is the same mechanism
+// postMessage uses between workers in a browser: it handles cycles, typed
+// arrays and maps/sets that JSON cannot, and transferable ArrayBuffers hand
+// over their contents without copying. SameProcess scope is what permits the
+// zero-copy transfer; the serialized buffer itself holds no GC pointers, so
+// it can safely cross threads while both contexts keep running.
+bool boilerplate::TransferChannel::Send(JSContext* cx, JS::HandleValue value,
+                                        JS::HandleValue transferables) {
+  auto buffer = std::make_unique<JSAutoStructuredCloneBuffer>(
+      JS::StructuredCloneScope::SameProcess, nullptr, nullptr);
+
+  if (!buffer->write(cx, value, transferables, JS::CloneDataPolicy(), nullptr,
+                     nullptr)) {
+    return false;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_queue.push_back(std::move(buffer));
+  }
+  m_cond.notify_one();
+  return true;
+}
+
+bool boilerplate::TransferChannel::Receive(JSContext* cx,
+                                           JS::MutableHandleValue out,
+                                           bool* closed) {
+  std::unique_ptr<JSAutoStructuredCloneBuffer> buffer;
+  {
+    std::unique_lock<std::mutex> guard(m_lock);
+    m_cond.wait(guard, [this] { return m_closed || !m_queue.empty(); });
+    if (m_queue.empty()) {
+      *closed = true;
+      return false;
+    }
+    buffer = std::move(m_queue.front());
+    m_queue.pop_front();
+  }
+
+  *closed = false;
+  // Deserializes into the receiver's current realm; a transferred
+  // ArrayBuffer adopts the sender's contents here without a copy.
+  return buffer->read(cx, out);
+}
+
+void boilerplate::TransferChannel::Close(void) {
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_closed = true;
+  }
+  m_cond.notify_all();
+}
+
+// Apply GC sizing and incremental-slice configuration. These map directly
+// onto JS_SetGCParameter keys; zero fields leave the engine default alone so
+// a config can override just one knob.
+void boilerplate::ApplyGCConfig(JSContext* cx, const GCConfig& config) {
+  if (config.heapMaxBytes) {
+    JS_SetGCParameter(cx, JSGC_MAX_BYTES, config.heapMaxBytes);
+  }
+  if (config.nurseryMaxBytes) {
+    JS_SetGCParameter(cx, JSGC_MAX_NURSERY_BYTES, config.nurseryMaxBytes);
+  }
+  JS_SetGCParameter(cx, JSGC_INCREMENTAL_GC_ENABLED, config.incremental);
+  if (config.sliceTimeBudgetMs) {
+    JS_SetGCParameter(cx, JSGC_SLICE_TIME_BUDGET_MS,
+                      config.sliceTimeBudgetMs);
+  }
+}
+
+// GC telemetry. The engine tells us about major collections (with a reason),
+// incremental slices, and nursery collections through three callbacks; we
+// time each window ourselves with a monotonic clock and accumulate into a
+// stats struct the embedding can export. Callbacks run on the context's
+// thread, so a single mutex guarding the struct is enough even with one
+// context per thread all reporting into the same stats.
+static std::mutex gcStatsLock;
+static boilerplate::GCStats gcStats;
+// Begin/end pairs nest per context, so the in-flight timestamps are
+// per-thread while the accumulated stats are shared.
+static thread_local std::chrono::steady_clock::time_point gcSliceStart;
+static thread_local std::chrono::steady_clock::time_point gcMinorStart;
+static thread_local uint32_t gcMinorHeapStart;
+
+static double MsSince(std::chrono::steady_clock::time_point start) {
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
+             elapsed)
+      .count();
+}
+
+static void GCMajorCallback(JSContext* cx, JSGCStatus status,
+                            JS::GCReason reason, void* data) {
+  if (status != JSGC_BEGIN) return;
+
+  std::lock_guard<std::mutex> guard(gcStatsLock);
+  gcStats.majorCollections++;
+  size_t index = size_t(reason);
+  if (index < sizeof(gcStats.reasonCounts) / sizeof(uint64_t)) {
+    gcStats.reasonCounts[index]++;
+  }
+}
+
+static void GCSliceCallback(JSContext* cx, JS::GCProgress progress,
+                            const JS::GCDescription& desc) {
+  switch (progress) {
+    case JS::GC_SLICE_BEGIN:
+      gcSliceStart = std::chrono::steady_clock::now();
+      break;
+    case JS::GC_SLICE_END: {
+      double pauseMs = MsSince(gcSliceStart);
+      std::lock_guard<std::mutex> guard(gcStatsLock);
+      gcStats.slices++;
+      gcStats.totalSlicePauseMs += pauseMs;
+      if (pauseMs > gcStats.maxSlicePauseMs) {
+        gcStats.maxSlicePauseMs = pauseMs;
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+static void GCNurseryCallback(JSContext* cx, JS::GCNurseryProgress progress,
+                              JS::GCReason reason) {
+  if (progress == JS::GCNurseryProgress::GC_NURSERY_COLLECTION_START) {
+    gcMinorStart = std::chrono::steady_clock::now();
+    gcMinorHeapStart = JS_GetGCParameter(cx, JSGC_BYTES);
+    return;
+  }
+
+  double pauseMs = MsSince(gcMinorStart);
+  // Tenured-heap growth across the collection stands in for promoted bytes
+  // (see the field comment in GCStats); clamp if the heap shrank.
+  uint32_t heapNow = JS_GetGCParameter(cx, JSGC_BYTES);
+  uint32_t promoted = heapNow > gcMinorHeapStart ? heapNow - gcMinorHeapStart
+                                                 : 0;
+
+  std::lock_guard<std::mutex> guard(gcStatsLock);
+  gcStats.minorCollections++;
+  gcStats.totalMinorPauseMs += pauseMs;
+  if (pauseMs > gcStats.maxMinorPauseMs) {
+    gcStats.maxMinorPauseMs = pauseMs;
+  }
+  gcStats.promotedBytesEstimate += promoted;
+}
+
+void boilerplate::AttachGCTelemetry(JSContext* cx) {
+  JS_SetGCCallback(cx, GCMajorCallback, nullptr);
+  JS::SetGCSliceCallback(cx, GCSliceCallback);
+  JS::SetGCNurseryCollectionCallback(cx, GCNurseryCallback);
+}
+
+boilerplate::GCStats boilerplate::GetGCStats(void) {
+  std::lock_guard<std::mutex> guard(gcStatsLock);
+  return gcStats;
+}
+
+void boilerplate::ResetGCStats(void) {
+  std::lock_guard<std::mutex> guard(gcStatsLock);
+  gcStats = GCStats();
+}
+
+// Per-native performance counters. Counters register themselves on a global
+// intrusive list at static-initialization time (they are file-scope statics,
+// constructed before main and before any worker threads exist, so the list
+// needs no locking). Each thread claims a slot index on first use; recording
+// touches only that thread's cache line.
+bool boilerplate::perfCountersEnabled = false;
+
+void boilerplate::SetPerfCountersEnabled(bool enabled) {
+  perfCountersEnabled = enabled;
+}
+
+uint64_t boilerplate::CycleTimestamp(void) {
+#if defined(__x86_64__)
+  return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+  uint64_t count;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(count));
+  return count;
+#else
+  return uint64_t(
+      std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+static boilerplate::PerfCounter* perfCounterList = nullptr;
+
+static std::atomic<unsigned> perfThreadCount{0};
+
+static unsigned PerfThreadSlot(void) {
+  static thread_local unsigned slot =
+      perfThreadCount.fetch_add(1) % boilerplate::PerfCounter::kThreadSlots;
+  return slot;
+}
+
+boilerplate::PerfCounter::PerfCounter(const char* name)
+    : m_name(name), m_next(perfCounterList) {
+  perfCounterList = this;
+}
+
+const boilerplate::PerfCounter* boilerplate::PerfCounter::First(void) {
+  return perfCounterList;
+}
+
+void boilerplate::PerfCounter::Record(uint64_t cycles, unsigned argc,
+                                      const JS::Value* argv) {
+  Slot& slot = m_slots[PerfThreadSlot()];
+  slot.calls.fetch_add(1, std::memory_order_relaxed);
+  slot.cycles.fetch_add(cycles, std::memory_order_relaxed);
+
+  for (unsigned i = 0; i < argc; i++) {
+    const JS::Value& v = argv[i];
+    ArgType type;
+    if (v.isInt32())
+      type = ArgInt32;
+    else if (v.isDouble())
+      type = ArgDouble;
+    else if (v.isBoolean())
+      type = ArgBoolean;
+    else if (v.isString())
+      type = ArgString;
+    else if (v.isObject())
+      type = ArgObject;
+    else if (v.isNull())
+      type = ArgNull;
+    else if (v.isUndefined())
+      type = ArgUndefined;
+    else
+      type = ArgOther;
+    slot.argTypes[type].fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+boilerplate::PerfCounter::Totals boilerplate::PerfCounter::Aggregate(void)
+    const {
+  Totals totals;
+  for (const Slot& slot : m_slots) {
+    totals.calls += slot.calls.load(std::memory_order_relaxed);
+    totals.cycles += slot.cycles.load(std::memory_order_relaxed);
+    for (size_t t = 0; t < kNumArgTypes; t++) {
+      totals.argTypes[t] += slot.argTypes[t].load(std::memory_order_relaxed);
+    }
+  }
+  return totals;
+}
+
+bool boilerplate::DumpPerfCounters(JSContext* cx, unsigned argc,
+                                   JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+
+  static const char* argTypeNames[PerfCounter::kNumArgTypes] = {
+      "int32", "double", "boolean", "string",
+      "object", "null", "undefined", "other"};
+
+  std::string json = "{\"counters\":[";
+  bool firstCounter = true;
+  for (const PerfCounter* counter = PerfCounter::First(); counter;
+       counter = counter->Next()) {
+    PerfCounter::Totals totals = counter->Aggregate();
+
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "%s{\"name\":\"%s\",\"calls\":%llu,\"cycles\":%llu,"
+             "\"argTypes\":{",
+             firstCounter ? "" : ",", counter->Name(),
+             (unsigned long long)totals.calls,
+             (unsigned long long)totals.cycles);
+    json += buf;
+    firstCounter = false;
+
+    for (size_t t = 0; t < PerfCounter::kNumArgTypes; t++) {
+      snprintf(buf, sizeof(buf), "%s\"%s\":%llu", t == 0 ? "" : ",",
+               argTypeNames[t], (unsigned long long)totals.argTypes[t]);
+      json += buf;
+    }
+    json += "}}";
+  }
+  json += "]}";
+
+  JSString* str = JS_NewStringCopyN(cx, json.data(), json.size());
+  if (!str) return false;
+  args.rval().setString(str);
+  return true;
+}
+
+// Pool of pre-registered rooted slots. Each JS::PersistentRootedValue is
+// registered with the GC exactly once, when it is created here; borrow() and
+// checkin() are just a vector pop/push, so a native that borrows a slot on
+// every call adds nothing to the root list churn that Rooted/PersistentRooted
+// construction would cost.
+bool boilerplate::ScratchRootPool::init(JSContext* cx, size_t capacity) {
+  m_cx = cx;
+  m_slots.reserve(capacity);
+  m_free.reserve(capacity);
+  for (size_t i = 0; i < capacity; i++) {
+    m_slots.push_back(std::make_unique<JS::PersistentRootedValue>(cx));
+    m_free.push_back(m_slots.back().get());
+  }
+  return true;
+}
+
+void boilerplate::ScratchRootPool::reset(void) {
+  // PersistentRooted must unregister before its context dies.
+  m_free.clear();
+  m_slots.clear();
+  m_cx = nullptr;
+}
+
+boilerplate::ScratchRootPool::Borrowed boilerplate::ScratchRootPool::borrow(
+    void) {
+  if (m_free.empty()) {
+    // Ran dry: grow by one slot, paying the registration cost now rather
+    // than on every future borrow.
+    m_slots.push_back(std::make_unique<JS::PersistentRootedValue>(m_cx));
+    m_free.push_back(m_slots.back().get());
+  }
+
+  JS::PersistentRootedValue* slot = m_free.back();
+  m_free.pop_back();
+
+  m_borrows++;
+  size_t inUse = m_slots.size() - m_free.size();
+  if (inUse > m_peakInUse) m_peakInUse = inUse;
+
+  return Borrowed(this, slot);
+}
+
+boilerplate::ScratchRootPool::Stats boilerplate::ScratchRootPool::GetStats(
+    void) const {
+  return {m_slots.size(), m_slots.size() - m_free.size(), m_peakInUse,
+          m_borrows};
+}
+
+// Slab allocator for JS::SetPrivate instance data. Blocks are carved out of
+// malloc'd slabs and recycled through an intrusive freelist; malloc is only
+// hit once per slab, so finalizer-heavy workloads stop contending on the
+// system allocator. Slabs are never returned to the OS until the arena dies,
+// which is the usual trade for pool allocators.
+boilerplate::PrivateArena::PrivateArena(size_t blockSize, size_t blocksPerSlab)
+    : m_blockSize(blockSize < sizeof(FreeBlock) ? sizeof(FreeBlock)
+                                                : blockSize),
+      m_blocksPerSlab(blocksPerSlab) {
+  // Keep every block suitably aligned for any instance type; malloc aligns
+  // the slab itself.
+  size_t align = alignof(std::max_align_t);
+  m_blockSize = (m_blockSize + align - 1) & ~(align - 1);
+}
+
+boilerplate::PrivateArena::~PrivateArena(void) {
+  for (void* slab : m_slabs) {
+    free(slab);
+  }
+}
+
+void* boilerplate::PrivateArena::Allocate(void) {
+  std::lock_guard<std::mutex> guard(m_lock);
+
+  if (!m_freeList) {
+    char* slab = static_cast<char*>(malloc(m_blockSize * m_blocksPerSlab));
+    if (!slab) return nullptr;
+    m_slabs.push_back(slab);
+
+    // Thread the fresh slab onto the freelist.
+    for (size_t i = 0; i < m_blocksPerSlab; i++) {
+      auto* block = reinterpret_cast<FreeBlock*>(slab + i * m_blockSize);
+      block->next = m_freeList;
+      m_freeList = block;
+    }
+  }
+
+  FreeBlock* block = m_freeList;
+  m_freeList = block->next;
+  m_live++;
+  if (m_live > m_peakLive) m_peakLive = m_live;
+  return block;
+}
+
+void boilerplate::PrivateArena::Deallocate(void* block) {
+  if (!block) return;
+
+  std::lock_guard<std::mutex> guard(m_lock);
+  auto* freed = static_cast<FreeBlock*>(block);
+  freed->next = m_freeList;
+  m_freeList = freed;
+  m_live--;
+}
+
+boilerplate::PrivateArena::Stats boilerplate::PrivateArena::GetStats(void) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  return {m_slabs.size(), m_slabs.size() * m_blocksPerSlab, m_live,
+          m_peakLive};
+}
+
 // Initialize the JS environment, create a JSContext and run the example
 // function in that context. By default the self-hosting environment is
 // initialized as it is needed to run any JavaScript). If the 'initSelfHosting'
@@ -53,7 +1120,9 @@ bool boilerplate::RunExample(bool (*task)(JSContext*), bool initSelfHosting) {
     return false;
   }
 
-  if (initSelfHosting && !JS::InitSelfHostedCode(cx)) {
+  ConfigureJitTieringFromEnv(cx);
+
+  if (initSelfHosting && !InitSelfHostedCodeCached(cx)) {
     return false;
   }
 
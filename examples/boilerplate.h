@@ -1,5 +1,20 @@
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <string>
+#include <vector>
+
 #include <jsapi.h>
 
+#include <js/Conversions.h>
+#include <js/StructuredClone.h>
+
 // See 'boilerplate.cpp' for documentation.
 
 namespace boilerplate {
@@ -8,8 +23,632 @@ extern const JSClassOps DefaultGlobalClassOps;
 
 JSObject* CreateGlobal(JSContext* cx);
 
+// Like CreateGlobal, but the new global's realm joins the compartment of
+// 'existing' instead of opening its own. Same-compartment realms call each
+// other without cross-compartment wrappers and share the per-compartment
+// bookkeeping; the trade is that they can no longer be collected or
+// torn down independently of the group.
+JSObject* CreateGlobalInSharedCompartment(JSContext* cx,
+                                          JS::HandleObject existing);
+
+// Tracks a group of tenant globals sharing one compartment: the first
+// created global opens the compartment, later ones join it, and TeardownAll
+// drops the whole group at once. The globals are held alive through a traced
+// container, so call TeardownAll (or reset) before context destruction.
+class TenantRealms {
+  struct Roots {
+    std::vector<JS::Heap<JSObject*>> globals;
+    void trace(JSTracer* trc);
+  };
+
+  JS::PersistentRooted<Roots> m_roots;
+
+ public:
+  bool init(JSContext* cx);
+  void reset(void);
+
+  JSObject* CreateTenantGlobal(JSContext* cx);
+  size_t Count(void) const;
+
+  // Release all tenant globals and run a shrinking GC to return the
+  // compartment's memory.
+  void TeardownAll(JSContext* cx);
+};
+
 void ReportAndClearException(JSContext* cx);
 
+// Fast error capture. ReportAndClearException builds a full report -- stack
+// formatting, side effects, per-failure allocations -- which is the right
+// thing at a REPL but far too heavy when errors are part of steady-state
+// traffic. CaptureError instead steals the pending exception into a
+// preallocated ring buffer as (message, filename, line, column), copied out
+// of the JSErrorReport the engine already attached to the Error object; no
+// report builder runs and nothing is allocated. Full formatting is deferred
+// until whatever drains the ring decides an entry is worth it.
+struct CapturedError {
+  char message[240];  // truncated if longer; empty-string terminated
+  char filename[64];
+  uint32_t lineno;
+  uint32_t column;
+};
+
+// Steal and capture the pending exception. Returns false if no exception
+// was pending; the exception is cleared either way. If the ring is full the
+// oldest entry is dropped (see CapturedErrorsDropped).
+bool CaptureError(JSContext* cx);
+
+// Move up to 'max' captured errors into 'out', oldest first; returns the
+// number written.
+size_t TakeCapturedErrors(CapturedError* out, size_t max);
+
+uint64_t CapturedErrorsDropped(void);
+
 bool RunExample(bool (*task)(JSContext*), bool initSelfHosting = true);
 
+// JS::InitSelfHostedCode with a snapshot: the first context in the process
+// compiles the self-hosted code and serializes it (to memory and, best
+// effort, to the file named by SELF_HOSTED_CACHE, default ".selfhosted.xdr");
+// every later context -- and later process runs -- deserializes instead of
+// recompiling. Used by RunExample, the context pool and RunParallel.
+bool InitSelfHostedCodeCached(JSContext* cx);
+
+// Evaluate a script file without first copying the whole source into a
+// buffer. Regular files are mmap'd and handed to the parser borrowed, so
+// there is exactly one copy of the source in memory (the page cache) and the
+// parser starts before the file has finished reading -- the kernel pages the
+// tail in, with readahead hinted, while the front is being parsed.
+// Non-seekable inputs (pipes, sockets) fall back to chunked reads into a
+// growing buffer. The completion value lands in 'result', as with
+// JS::Evaluate; on failure an exception is pending (or reported via errno
+// for I/O errors, with a JS error set).
+bool EvaluateFile(JSContext* cx, const char* path,
+                  JS::MutableHandleValue result);
+
+// JIT tiering controls. A script starts in the interpreter and tiers up to
+// Baseline and then the optimizing compiler only after its warm-up counter
+// crosses the engine's triggers -- and the counter belongs to the script, so
+// cached scripts cloned into fresh per-request realms re-warm from zero every
+// time. Lowering the triggers (process-wide JIT compiler options; they are
+// not part of JS::CompileOptions) lets known-hot code reach its tier within
+// the first few executions of each run instead.
+struct JitTierConfig {
+  // Executions before a script gets Baseline-compiled, and before Baseline
+  // code tiers up to the optimizing compiler. UINT32_MAX means "leave the
+  // engine default in place".
+  uint32_t baselineWarmupTrigger = UINT32_MAX;
+  uint32_t ionWarmupTrigger = UINT32_MAX;
+
+  // Compile straight to the top tier (both triggers forced to zero). A
+  // known-hot cached script then runs optimized from its first execution,
+  // at the price of compiling before any type feedback exists -- only worth
+  // it for code already measured hot.
+  bool forceFullJit = false;
+};
+
+void ConfigureJitTiering(JSContext* cx, const JitTierConfig& config);
+
+// Read the config from the environment: JIT_BASELINE_WARMUP and
+// JIT_ION_WARMUP set the triggers, JIT_FORCE_FULL=1 selects forceFullJit.
+// Unset variables leave the engine defaults. RunExample, the context pool
+// and RunParallel apply this to every context they create.
+void ConfigureJitTieringFromEnv(JSContext* cx);
+
+// The triggers currently in effect, as reported back by the engine.
+JitTierConfig GetJitTierConfig(JSContext* cx);
+
+// The tier a script with 'runCount' executions has reached under the current
+// triggers: "interpreter", "baseline" or "ion". This SpiderMonkey has no
+// public per-script tier query, so callers that keep execution counts for
+// their cached scripts (the natural companion to a script cache) infer the
+// tier from the same counters the engine uses.
+const char* PredictedJitTier(JSContext* cx, uint64_t runCount);
+
+// Context pool: pre-warmed JSContexts with self-hosted code already
+// initialized, so a "run" is a checkout plus a fresh global instead of a full
+// JS_NewContext / InitSelfHostedCode cycle.
+bool InitContextPool(unsigned poolSize);
+void ShutdownContextPool(void);
+
+JSContext* CheckoutContext(void);
+void CheckinContext(JSContext* cx);
+
+// RAII checkout/checkin.
+class AutoPooledContext {
+  JSContext* m_cx;
+
+ public:
+  AutoPooledContext(void) : m_cx(CheckoutContext()) {}
+  ~AutoPooledContext(void) {
+    if (m_cx) CheckinContext(m_cx);
+  }
+  AutoPooledContext(const AutoPooledContext&) = delete;
+  AutoPooledContext& operator=(const AutoPooledContext&) = delete;
+
+  JSContext* get(void) const { return m_cx; }
+  explicit operator bool(void) const { return m_cx != nullptr; }
+};
+
+// Run a task on a pooled context. The task creates its own global (realm), as
+// with RunExample; the expensive context setup is amortized across runs.
+bool RunPooledExample(bool (*task)(JSContext*));
+
+// Class-registration cache for embeddings that create a fresh global per
+// request. JS_InitClass re-parses the spec tables and re-atomizes every
+// property name on each call; RegisterClass does that work once, pinning the
+// name atoms and keeping their interned ids, and InstallClasses replays the
+// cached definitions onto a new global with JS_Define*ById calls -- no spec
+// parsing, no atomization.
+//
+// The method/getter tables are terminated by an entry with a null name, like
+// the JSAPI spec arrays. Pinned atoms live until JS_ShutDown, so the
+// registry must not be reused across JS_Init cycles.
+struct ClassMethod {
+  const char* name;
+  JSNative native;
+  uint16_t nargs;
+};
+
+struct ClassGetter {
+  const char* name;
+  JSNative getter;
+};
+
+struct ClassSpec {
+  const JSClass* clasp;
+  JSNative constructor;
+  unsigned ctorNargs;
+  const ClassMethod* methods;           // prototype methods, may be nullptr
+  const ClassGetter* properties;        // prototype getters, may be nullptr
+  const ClassMethod* staticMethods;     // on the constructor, may be nullptr
+  const ClassGetter* staticProperties;  // on the constructor, may be nullptr
+};
+
+bool RegisterClass(JSContext* cx, const ClassSpec& spec);
+bool InstallClasses(JSContext* cx, JS::HandleObject global);
+
+// Multi-threaded harness: run the task on nThreads threads, each with its own
+// JSContext. SpiderMonkey allows one active context per thread; contexts
+// share nothing, so tasks need no locking against each other.
+bool RunParallel(bool (*task)(JSContext*), unsigned nThreads);
+
+// Same harness, but the threads drain a shared queue of script sources, each
+// evaluated against the executing thread's own global. Returns false if any
+// job fails.
+bool RunParallelJobs(const std::vector<std::string>& scripts,
+                     unsigned nThreads);
+
+// A channel for moving values between contexts (e.g. a RunParallel worker and
+// a coordinator) via structured clone rather than JSON. ArrayBuffers listed
+// in the transferables argument move their contents without a copy; the
+// serialized form is context-independent so sender and receiver never touch
+// each other's heaps.
+class TransferChannel {
+  std::mutex m_lock;
+  std::condition_variable m_cond;
+  std::deque<std::unique_ptr<JSAutoStructuredCloneBuffer>> m_queue;
+  bool m_closed = false;
+
+ public:
+  // Serialize 'value' on the sender's context and enqueue it. 'transferables'
+  // is an array of ArrayBuffers to transfer (or undefined for none); a
+  // transferred buffer is detached on the sender side.
+  bool Send(JSContext* cx, JS::HandleValue value,
+            JS::HandleValue transferables);
+
+  // Block until a value is available (or the channel is closed) and
+  // deserialize it into the receiver's current realm. Returns false with
+  // *closed set if the channel was closed, or with an exception pending on
+  // deserialization failure.
+  bool Receive(JSContext* cx, JS::MutableHandleValue out, bool* closed);
+
+  // Wake all receivers; subsequent receives fail with *closed = true.
+  void Close(void);
+};
+
+// GC tuning knobs applied to a context at startup. The defaults mirror what
+// JS_NewContext gives you; production embeddings will want to size the heap
+// and nursery for their workload and bound incremental slice times to bound
+// pause latency.
+struct GCConfig {
+  uint32_t heapMaxBytes = 0;        // 0 = leave at JS::DefaultHeapMaxBytes
+  uint32_t nurseryMaxBytes = 0;     // 0 = leave at engine default
+  uint32_t sliceTimeBudgetMs = 0;   // 0 = unlimited slices
+  bool incremental = true;
+};
+void ApplyGCConfig(JSContext* cx, const GCConfig& config);
+
+// GC telemetry accumulated from the engine's GC callbacks. All counters are
+// cumulative since AttachGCTelemetry; pause times cover both full collections
+// (from the GC callback) and individual incremental slices (from the slice
+// callback), since the slices are what user code actually observes as pauses.
+struct GCStats {
+  uint64_t majorCollections = 0;
+  uint64_t minorCollections = 0;
+  uint64_t slices = 0;
+  double totalSlicePauseMs = 0;
+  double maxSlicePauseMs = 0;
+  double totalMinorPauseMs = 0;
+  double maxMinorPauseMs = 0;
+  // Bytes tenured out of the nursery, estimated as the GC-heap growth
+  // (JSGC_BYTES) across each minor collection: the public API reports no
+  // promotion counts, so this is the closest observable. It reads high if
+  // the callback races other allocation and clamps to zero if the heap
+  // shrank meanwhile. Promotion rate is this over minorCollections.
+  uint64_t promotedBytesEstimate = 0;
+  // Major collections by JS::GCReason, for attributing who triggered them.
+  // Index with uint8_t(reason); use JS::ExplainGCReason to print.
+  uint64_t reasonCounts[64] = {};
+};
+
+void AttachGCTelemetry(JSContext* cx);
+GCStats GetGCStats(void);
+void ResetGCStats(void);
+
+// Per-native performance counters. A PerfCounter is declared as a file-scope
+// static next to the native it measures, and the native is registered through
+// the Counted wrapper instead of directly:
+//
+//   static boilerplate::PerfCounter fooCounter("foo");
+//   JS_FN("foo", (boilerplate::Counted<Foo, &fooCounter>), 0, 0),
+//
+// When counters are disabled (the default) the wrapper is one predictable
+// branch ahead of the real native. When enabled it records call count,
+// elapsed cycles (rdtsc on x86-64, the generic counter on AArch64) and a
+// histogram of argument types, into cache-line-padded per-thread slots so
+// concurrent RunParallel workers don't bounce a line between cores.
+// DumpPerfCounters is a JSNative returning the accumulated numbers as JSON;
+// register it as e.g. "dumpPerfCounters" wherever it's wanted.
+class PerfCounter {
+ public:
+  static constexpr size_t kThreadSlots = 64;
+
+  enum ArgType {
+    ArgInt32,
+    ArgDouble,
+    ArgBoolean,
+    ArgString,
+    ArgObject,
+    ArgNull,
+    ArgUndefined,
+    ArgOther,
+    kNumArgTypes,
+  };
+
+  explicit PerfCounter(const char* name);
+
+  void Record(uint64_t cycles, unsigned argc, const JS::Value* argv);
+
+  // Iteration and aggregation across thread slots, for dumping.
+  struct Totals {
+    uint64_t calls = 0;
+    uint64_t cycles = 0;
+    uint64_t argTypes[kNumArgTypes] = {};
+  };
+  static const PerfCounter* First(void);
+  const PerfCounter* Next(void) const { return m_next; }
+  const char* Name(void) const { return m_name; }
+  Totals Aggregate(void) const;
+
+ private:
+  // One cache line per thread (the first kThreadSlots of them; when more
+  // threads than slots exist, slot-mates share). Relaxed atomics keep the
+  // shared case well-defined -- no increment is ever lost -- at no cost in
+  // the common uncontended case, where a relaxed fetch_add on x86-64 and
+  // AArch64 is an ordinary uncontended RMW on a line this thread owns.
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> cycles{0};
+    std::atomic<uint64_t> argTypes[kNumArgTypes] = {};
+  };
+
+  const char* m_name;
+  PerfCounter* m_next;
+  Slot m_slots[kThreadSlots];
+};
+
+// Deliberately a plain bool: the disabled-path check must stay a single
+// non-atomic load and branch. Toggling while natives are running is benign
+// (a call is either counted or not).
+extern bool perfCountersEnabled;
+void SetPerfCountersEnabled(bool enabled);
+
+uint64_t CycleTimestamp(void);
+
+template <JSNative F, PerfCounter* Counter>
+bool Counted(JSContext* cx, unsigned argc, JS::Value* vp) {
+  if (!perfCountersEnabled) return F(cx, argc, vp);
+
+  uint64_t start = CycleTimestamp();
+  bool ok = F(cx, argc, vp);
+  uint64_t elapsed = CycleTimestamp() - start;
+
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  Counter->Record(elapsed, args.length(), args.array());
+  return ok;
+}
+
+// JSNative: dumpPerfCounters() -> JSON string of all counters.
+bool DumpPerfCounters(JSContext* cx, unsigned argc, JS::Value* vp);
+
+// A pool of pre-registered rooted value slots. Registering and unregistering
+// roots with the GC has measurable cost when done rapidly (see the note in
+// tracing.cpp about PersistentRooted churn); hot native functions can instead
+// borrow a slot that was rooted once at startup and hand it back when done,
+// so steady-state calls never touch the GC root list at all. Writes go
+// through the PersistentRooted itself, so all barriers apply as usual.
+//
+// The pool is for one thread/context; init() pre-registers 'capacity' slots
+// and borrow() grows the pool (paying the registration cost once per new
+// slot) if it ever runs dry. reset() must be called before the context is
+// destroyed.
+class ScratchRootPool {
+  std::vector<std::unique_ptr<JS::PersistentRootedValue>> m_slots;
+  std::vector<JS::PersistentRootedValue*> m_free;
+  JSContext* m_cx = nullptr;
+  size_t m_borrows = 0;
+  size_t m_peakInUse = 0;
+
+  void checkin(JS::PersistentRootedValue* slot) {
+    slot->setUndefined();  // don't keep borrowed values alive
+    m_free.push_back(slot);
+  }
+
+ public:
+  bool init(JSContext* cx, size_t capacity);
+  void reset(void);
+
+  // RAII borrow of one rooted slot.
+  class Borrowed {
+    ScratchRootPool* m_pool;
+    JS::PersistentRootedValue* m_slot;
+
+   public:
+    Borrowed(ScratchRootPool* pool, JS::PersistentRootedValue* slot)
+        : m_pool(pool), m_slot(slot) {}
+    Borrowed(Borrowed&& other) : m_pool(other.m_pool), m_slot(other.m_slot) {
+      other.m_slot = nullptr;
+    }
+    Borrowed(const Borrowed&) = delete;
+    Borrowed& operator=(const Borrowed&) = delete;
+    ~Borrowed(void) {
+      if (m_slot) m_pool->checkin(m_slot);
+    }
+
+    JS::HandleValue handle(void) const { return *m_slot; }
+    JS::MutableHandleValue mutableHandle(void) { return &*m_slot; }
+    void set(const JS::Value& v) { *m_slot = v; }
+  };
+
+  Borrowed borrow(void);
+
+  struct Stats {
+    size_t capacity;
+    size_t inUse;
+    size_t peakInUse;
+    size_t borrows;
+  };
+  Stats GetStats(void) const;
+};
+
+// Slab allocator for the native instance structs stored behind
+// JS::SetPrivate. Classes that create many short-lived instances pay one
+// malloc per object (and the matching free in the finalizer); allocating
+// fixed-size blocks out of slabs instead turns that into a freelist pop/push
+// and keeps instances of one class densely packed.
+class PrivateArena {
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  std::mutex m_lock;
+  size_t m_blockSize;
+  size_t m_blocksPerSlab;
+  std::vector<void*> m_slabs;
+  FreeBlock* m_freeList = nullptr;
+  size_t m_live = 0;
+  size_t m_peakLive = 0;
+
+ public:
+  explicit PrivateArena(size_t blockSize, size_t blocksPerSlab = 256);
+  ~PrivateArena(void);
+  PrivateArena(const PrivateArena&) = delete;
+  PrivateArena& operator=(const PrivateArena&) = delete;
+
+  void* Allocate(void);
+  void Deallocate(void* block);
+
+  // Occupancy statistics, e.g. for sizing blocksPerSlab.
+  struct Stats {
+    size_t slabs;      // slabs allocated from malloc
+    size_t capacity;   // total blocks across all slabs
+    size_t live;       // blocks currently handed out
+    size_t peakLive;   // high-water mark of live blocks
+  };
+  Stats GetStats(void);
+};
+
+// Compile-time JSNative generator. Bind<&F> produces a JSNative that checks
+// arity against a compile-time constant, unwraps each argument into the
+// corresponding C++ parameter type and wraps the return value, so plain C++
+// functions can go straight into a JSFunctionSpec:
+//
+//   static int32_t AddIntegers(int32_t a, int32_t b) { return a + b; }
+//   JS_FN("addIntegers", boilerplate::Bind<&AddIntegers>, 2, 0),
+//
+// The unwrapping is specialized per type at compile time, with the dynamic
+// conversion only as a fallback: an int32_t parameter reads v.toInt32()
+// directly when isInt32() and only then falls back to JS::ToInt32; a
+// std::string parameter copies Latin-1 characters straight out of the linear
+// string without a general transcoding pass. Supported parameter types are
+// int32_t, double, bool and std::string (UTF-8); supported returns are those
+// plus void. Natives that need the JSContext, `this`, or object arguments
+// keep the hand-written JS::CallArgs form.
+namespace detail {
+
+template <typename T>
+struct NativeArg;
+
+template <>
+struct NativeArg<int32_t> {
+  static bool Unwrap(JSContext* cx, JS::HandleValue v, int32_t* out) {
+    if (v.isInt32()) {
+      *out = v.toInt32();
+      return true;
+    }
+    return JS::ToInt32(cx, v, out);
+  }
+};
+
+template <>
+struct NativeArg<double> {
+  static bool Unwrap(JSContext* cx, JS::HandleValue v, double* out) {
+    if (v.isNumber()) {
+      *out = v.toNumber();
+      return true;
+    }
+    return JS::ToNumber(cx, v, out);
+  }
+};
+
+template <>
+struct NativeArg<bool> {
+  static bool Unwrap(JSContext* cx, JS::HandleValue v, bool* out) {
+    *out = JS::ToBoolean(v);
+    return true;
+  }
+};
+
+template <>
+struct NativeArg<std::string> {
+  static bool Unwrap(JSContext* cx, JS::HandleValue v, std::string* out) {
+    JS::RootedString str(cx,
+                         v.isString() ? v.toString() : JS::ToString(cx, v));
+    if (!str) return false;
+
+    JSLinearString* linear = JS_EnsureLinearString(cx, str);
+    if (!linear) return false;
+
+    if (JS_LinearStringHasLatin1Chars(linear)) {
+      // Latin-1 maps to UTF-8 with at most two bytes per character; copy
+      // directly instead of going through a generic encoder.
+      size_t length = JS_GetStringLength(str);
+      out->clear();
+      out->reserve(length);
+      JS::AutoCheckCannotGC nogc;
+      const JS::Latin1Char* chars =
+          JS_GetLatin1LinearStringChars(nogc, linear);
+      for (size_t i = 0; i < length; i++) {
+        JS::Latin1Char c = chars[i];
+        if (c < 0x80) {
+          out->push_back(char(c));
+        } else {
+          out->push_back(char(0xc0 | (c >> 6)));
+          out->push_back(char(0x80 | (c & 0x3f)));
+        }
+      }
+      return true;
+    }
+
+    JS::UniqueChars utf8 = JS_EncodeStringToUTF8(cx, str);
+    if (!utf8) return false;
+    out->assign(utf8.get());
+    return true;
+  }
+};
+
+inline bool SetResult(JSContext* cx, JS::CallArgs& args, int32_t v) {
+  args.rval().setInt32(v);
+  return true;
+}
+
+inline bool SetResult(JSContext* cx, JS::CallArgs& args, double v) {
+  args.rval().setNumber(v);
+  return true;
+}
+
+inline bool SetResult(JSContext* cx, JS::CallArgs& args, bool v) {
+  args.rval().setBoolean(v);
+  return true;
+}
+
+inline bool SetResult(JSContext* cx, JS::CallArgs& args,
+                      const std::string& v) {
+  JSString* str = JS_NewStringCopyN(cx, v.data(), v.size());
+  if (!str) return false;
+  args.rval().setString(str);
+  return true;
+}
+
+template <typename T>
+struct FunctionTraits;
+
+template <typename R, typename... A>
+struct FunctionTraits<R (*)(A...)> {
+  using Return = R;
+  using ArgsTuple = std::tuple<std::decay_t<A>...>;
+  static constexpr unsigned arity = sizeof...(A);
+};
+
+template <typename Tuple, size_t... I>
+bool UnwrapAll(JSContext* cx, const JS::CallArgs& args, Tuple& values,
+               std::index_sequence<I...>) {
+  // Fold over && evaluates left to right and stops at the first failure.
+  return (NativeArg<std::tuple_element_t<I, Tuple>>::Unwrap(
+              cx, args[I], &std::get<I>(values)) &&
+          ...);
+}
+
+}  // namespace detail
+
+template <auto F>
+bool Bind(JSContext* cx, unsigned argc, JS::Value* vp) {
+  using Traits = detail::FunctionTraits<decltype(F)>;
+
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  if (args.length() < Traits::arity) {
+    JS_ReportErrorASCII(cx, "expected %u arguments, got %u", Traits::arity,
+                        args.length());
+    return false;
+  }
+
+  typename Traits::ArgsTuple values;
+  if (!detail::UnwrapAll(cx, args, values,
+                         std::make_index_sequence<Traits::arity>{}))
+    return false;
+
+  if constexpr (std::is_void_v<typename Traits::Return>) {
+    std::apply(F, values);
+    args.rval().setUndefined();
+    return true;
+  } else {
+    return detail::SetResult(cx, args, std::apply(F, values));
+  }
+}
+
+// Typed convenience wrapper: New/Delete counterparts of new/delete that
+// allocate from a PrivateArena. Intended use is a static pool per JSClass,
+// with the class's finalize hook calling Delete.
+template <typename T>
+class ArenaPool {
+  PrivateArena m_arena;
+
+ public:
+  ArenaPool(void) : m_arena(sizeof(T)) {}
+
+  template <typename... Args>
+  T* New(Args&&... args) {
+    void* block = m_arena.Allocate();
+    if (!block) return nullptr;
+    return new (block) T(std::forward<Args>(args)...);
+  }
+
+  void Delete(T* instance) {
+    if (!instance) return;
+    instance->~T();
+    m_arena.Deallocate(instance);
+  }
+
+  PrivateArena::Stats GetStats(void) { return m_arena.GetStats(); }
+};
+
 }  // namespace boilerplate
@@ -0,0 +1,463 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include <jsapi.h>
+#include <jsfriendapi.h>
+#include "js/experimental/TypedData.h"
+
+#include <js/CompilationAndEvaluation.h>
+#include <js/Conversions.h>
+#include <js/Initialization.h>
+#include <js/SourceText.h>
+
+#include "boilerplate.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define HAVE_X86_AVX2 1
+#endif
+
+/* This example generalizes the pinned-typed-array pattern from resolve.cpp
+ * (JS_Get*ArrayData under JS::AutoAssertNoGC) into a small bulk-transform
+ * API: a `BulkOps` object whose methods run whole-array kernels -- saxpy,
+ * sum/min/max reductions, a 32-bit byteswap and a memchr-style scan -- in a
+ * single JS-to-native crossing. Doing these loops in JS costs a boxed
+ * element access per iteration; here the loop body is a few instructions
+ * over pinned memory and the compiler's vectorizer gets a clean shot at it.
+ *
+ * The properties resolve lazily through the same resolve-hook machinery as
+ * the Crc class, so the kernels cost nothing unless a script touches them. */
+
+namespace bulkkernels {
+
+/* Every kernel is a plain dependency-free loop that the compiler can
+ * auto-vectorize. On x86-64 the float kernels are compiled a second time
+ * under the AVX2 (+FMA) target attribute, which lets the vectorizer use
+ * 256-bit lanes while the rest of the binary stays baseline; the dispatcher
+ * takes that version when cpuid reports AVX2. On AArch64 the baseline build
+ * already includes NEON, so the portable loop is the vector loop. */
+
+template <typename T>
+static void SaxpyPortable(T a, const T* x, T* y, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    y[i] = a * x[i] + y[i];
+  }
+}
+
+template <typename T>
+static double SumPortable(const T* x, size_t n) {
+  /* Four independent accumulators, same trick as the XXH64 stripe loop in
+   * resolve.cpp: no cross-iteration dependency chain, so the lanes can run
+   * in parallel. (This changes summation order versus a naive JS loop,
+   * which is the usual trade for a vector reduction.) */
+  double acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    acc0 += x[i];
+    acc1 += x[i + 1];
+    acc2 += x[i + 2];
+    acc3 += x[i + 3];
+  }
+  for (; i < n; i++) acc0 += x[i];
+  return (acc0 + acc1) + (acc2 + acc3);
+}
+
+/* NaN-ignoring min/max, like Math.min over finite data. Plain comparisons
+ * keep the loop branchless enough for min/max vector instructions. */
+template <typename T>
+static T MinPortable(const T* x, size_t n) {
+  T m = x[0];
+  for (size_t i = 1; i < n; i++) {
+    if (x[i] < m) m = x[i];
+  }
+  return m;
+}
+
+template <typename T>
+static T MaxPortable(const T* x, size_t n) {
+  T m = x[0];
+  for (size_t i = 1; i < n; i++) {
+    if (x[i] > m) m = x[i];
+  }
+  return m;
+}
+
+static void Byteswap32Portable(uint32_t* x, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    x[i] = __builtin_bswap32(x[i]);
+  }
+}
+
+#ifdef HAVE_X86_AVX2
+__attribute__((target("avx2,fma"))) static void SaxpyF32Avx2(float a,
+                                                             const float* x,
+                                                             float* y,
+                                                             size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    y[i] = a * x[i] + y[i];
+  }
+}
+
+__attribute__((target("avx2,fma"))) static void SaxpyF64Avx2(double a,
+                                                             const double* x,
+                                                             double* y,
+                                                             size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    y[i] = a * x[i] + y[i];
+  }
+}
+
+static bool HaveAvx2(void) { return __builtin_cpu_supports("avx2"); }
+#endif
+
+static void Saxpy(float a, const float* x, float* y, size_t n) {
+#ifdef HAVE_X86_AVX2
+  static const bool avx2 = HaveAvx2();
+  if (avx2) return SaxpyF32Avx2(a, x, y, n);
+#endif
+  SaxpyPortable(a, x, y, n);
+}
+
+static void Saxpy(double a, const double* x, double* y, size_t n) {
+#ifdef HAVE_X86_AVX2
+  static const bool avx2 = HaveAvx2();
+  if (avx2) return SaxpyF64Avx2(a, x, y, n);
+#endif
+  SaxpyPortable(a, x, y, n);
+}
+
+/* First index of 'byte' in x, or -1. memchr is the canonical vectorized
+ * byte scan on every libc we care about. */
+static int64_t Scan(const uint8_t* x, size_t n, uint8_t byte) {
+  const void* hit = memchr(x, byte, n);
+  if (!hit) return -1;
+  return static_cast<const uint8_t*>(hit) - x;
+}
+
+}  // namespace bulkkernels
+
+class BulkOps {
+  /* One float array argument, pinned. The caller branches on 'isDouble' to
+   * pick the element type; the AutoAssertNoGC in the caller's scope is what
+   * keeps the data pointer valid. */
+  static JSObject* requireFloatArray(JSContext* cx, JS::HandleValue arg,
+                                     const char* method, bool* isDouble) {
+    if (!arg.isObject()) {
+      JS_ReportErrorASCII(
+          cx, "argument to %s() should be a Float32Array or Float64Array",
+          method);
+      return nullptr;
+    }
+    JSObject* buffer = &arg.toObject();
+    if (JS_IsFloat32Array(buffer)) {
+      *isDouble = false;
+      return buffer;
+    }
+    if (JS_IsFloat64Array(buffer)) {
+      *isDouble = true;
+      return buffer;
+    }
+    JS_ReportErrorASCII(
+        cx, "argument to %s() should be a Float32Array or Float64Array",
+        method);
+    return nullptr;
+  }
+
+  // y[i] = a * x[i] + y[i], in place. x and y must be float arrays of the
+  // same element type; the kernel runs over min(len(x), len(y)) elements.
+  static bool saxpy(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    if (!args.requireAtLeast(cx, "saxpy", 3)) return false;
+
+    double a;
+    if (!JS::ToNumber(cx, args[0], &a)) return false;
+
+    bool xIsDouble, yIsDouble;
+    JSObject* xBuf = requireFloatArray(cx, args[1], "saxpy", &xIsDouble);
+    if (!xBuf) return false;
+    JSObject* yBuf = requireFloatArray(cx, args[2], "saxpy", &yIsDouble);
+    if (!yBuf) return false;
+    if (xIsDouble != yIsDouble) {
+      JS_ReportErrorASCII(cx, "saxpy() arrays must have the same element type");
+      return false;
+    }
+
+    size_t n = std::min(JS_GetTypedArrayLength(xBuf),
+                        JS_GetTypedArrayLength(yBuf));
+
+    {
+      bool isSharedMemory;
+      JS::AutoAssertNoGC nogc;
+      if (xIsDouble) {
+        const double* x = JS_GetFloat64ArrayData(xBuf, &isSharedMemory, nogc);
+        double* y = JS_GetFloat64ArrayData(yBuf, &isSharedMemory, nogc);
+        bulkkernels::Saxpy(a, x, y, n);
+      } else {
+        const float* x = JS_GetFloat32ArrayData(xBuf, &isSharedMemory, nogc);
+        float* y = JS_GetFloat32ArrayData(yBuf, &isSharedMemory, nogc);
+        bulkkernels::Saxpy(float(a), x, y, n);
+      }
+    }
+
+    args.rval().setUndefined();
+    return true;
+  }
+
+  enum class Reduction { Sum, Min, Max };
+
+  static bool reduce(JSContext* cx, const JS::CallArgs& args,
+                     const char* method, Reduction op) {
+    if (!args.requireAtLeast(cx, method, 1)) return false;
+
+    bool isDouble;
+    JSObject* buffer = requireFloatArray(cx, args[0], method, &isDouble);
+    if (!buffer) return false;
+
+    size_t n = JS_GetTypedArrayLength(buffer);
+    if (n == 0 && op != Reduction::Sum) {
+      JS_ReportErrorASCII(cx, "%s() of an empty array", method);
+      return false;
+    }
+
+    double result = 0;
+    {
+      bool isSharedMemory;
+      JS::AutoAssertNoGC nogc;
+      if (isDouble) {
+        const double* x = JS_GetFloat64ArrayData(buffer, &isSharedMemory, nogc);
+        if (op == Reduction::Sum)
+          result = bulkkernels::SumPortable(x, n);
+        else if (op == Reduction::Min)
+          result = bulkkernels::MinPortable(x, n);
+        else
+          result = bulkkernels::MaxPortable(x, n);
+      } else {
+        const float* x = JS_GetFloat32ArrayData(buffer, &isSharedMemory, nogc);
+        if (op == Reduction::Sum)
+          result = bulkkernels::SumPortable(x, n);
+        else if (op == Reduction::Min)
+          result = bulkkernels::MinPortable(x, n);
+        else
+          result = bulkkernels::MaxPortable(x, n);
+      }
+    }
+
+    args.rval().setNumber(result);
+    return true;
+  }
+
+  static bool sum(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    return reduce(cx, args, "sum", Reduction::Sum);
+  }
+
+  static bool min(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    return reduce(cx, args, "min", Reduction::Min);
+  }
+
+  static bool max(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    return reduce(cx, args, "max", Reduction::Max);
+  }
+
+  // Swap the byte order of every element of a Uint32Array, in place.
+  static bool byteswap(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    if (!args.requireAtLeast(cx, "byteswap", 1)) return false;
+
+    if (!args[0].isObject() || !JS_IsUint32Array(&args[0].toObject())) {
+      JS_ReportErrorASCII(cx, "argument to byteswap() should be a Uint32Array");
+      return false;
+    }
+    JSObject* buffer = &args[0].toObject();
+
+    size_t n = JS_GetTypedArrayLength(buffer);
+    {
+      bool isSharedMemory;
+      JS::AutoAssertNoGC nogc;
+      uint32_t* x = JS_GetUint32ArrayData(buffer, &isSharedMemory, nogc);
+      bulkkernels::Byteswap32Portable(x, n);
+    }
+
+    args.rval().setUndefined();
+    return true;
+  }
+
+  // Index of the first occurrence of a byte value in a Uint8Array, or -1.
+  static bool scan(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    if (!args.requireAtLeast(cx, "scan", 2)) return false;
+
+    if (!args[0].isObject() || !JS_IsUint8Array(&args[0].toObject())) {
+      JS_ReportErrorASCII(cx, "argument to scan() should be a Uint8Array");
+      return false;
+    }
+    JSObject* buffer = &args[0].toObject();
+
+    int32_t byte;
+    if (!JS::ToInt32(cx, args[1], &byte)) return false;
+
+    size_t n = JS_GetTypedArrayLength(buffer);
+    int64_t index;
+    {
+      bool isSharedMemory;
+      JS::AutoAssertNoGC nogc;
+      const uint8_t* x = JS_GetUint8ArrayData(buffer, &isSharedMemory, nogc);
+      index = bulkkernels::Scan(x, n, uint8_t(byte));
+    }
+
+    args.rval().setNumber(double(index));
+    return true;
+  }
+
+  // The lazily-resolved methods, same shape as Crc::lazyProperties; all
+  // entries here are methods, no getters, since BulkOps carries no state.
+  struct LazyProperty {
+    const char* name;
+    JSNative method;
+    unsigned nargs;
+  };
+
+  static constexpr LazyProperty lazyProperties[] = {
+      {"saxpy", &BulkOps::saxpy, 3}, {"sum", &BulkOps::sum, 1},
+      {"min", &BulkOps::min, 1},     {"max", &BulkOps::max, 1},
+      {"byteswap", &BulkOps::byteswap, 1},
+      {"scan", &BulkOps::scan, 2},
+  };
+
+  static bool newEnumerate(JSContext* cx, JS::HandleObject obj,
+                           JS::MutableHandleIdVector properties,
+                           bool enumerableOnly) {
+    for (const LazyProperty& prop : lazyProperties) {
+      jsid id = JS::PropertyKey::fromPinnedString(
+          JS_AtomizeAndPinString(cx, prop.name));
+      if (!properties.append(id)) return false;
+    }
+    return true;
+  }
+
+  static bool resolve(JSContext* cx, JS::HandleObject obj, JS::HandleId id,
+                      bool* resolved) {
+    if (!JSID_IS_STRING(id)) {
+      *resolved = false;
+      return true;
+    }
+
+    JSLinearString* str = JSID_TO_LINEAR_STRING(id);
+
+    for (const LazyProperty& prop : lazyProperties) {
+      if (!JS_LinearStringEqualsAscii(str, prop.name)) continue;
+
+      if (!JS_DefineFunctionById(cx, obj, id, prop.method, prop.nargs,
+                                 JSPROP_ENUMERATE))
+        return false;
+      *resolved = true;
+      return true;
+    }
+
+    *resolved = false;
+    return true;
+  }
+
+  static bool mayResolve(const JSAtomState& names, jsid id,
+                         JSObject* maybeObj) {
+    if (!JSID_IS_STRING(id)) return false;
+
+    JSLinearString* str = JSID_TO_LINEAR_STRING(id);
+    for (const LazyProperty& prop : lazyProperties) {
+      if (JS_LinearStringEqualsAscii(str, prop.name)) return true;
+    }
+    return false;
+  }
+
+  static constexpr JSClassOps classOps = {
+      nullptr,  // addProperty
+      nullptr,  // deleteProperty
+      nullptr,  // enumerate
+      &BulkOps::newEnumerate,
+      &BulkOps::resolve,
+      &BulkOps::mayResolve,
+  };
+
+  static constexpr JSClass klass = {
+      "BulkOps",
+      0,
+      &BulkOps::classOps,
+  };
+
+ public:
+  // Unlike Crc there are no instances: the kernels are stateless, so we hang
+  // a single object of the class off the global as `BulkOps`.
+  static bool Define(JSContext* cx) {
+    JS::RootedObject global(cx, JS::CurrentGlobalOrNull(cx));
+    JS::RootedObject obj(cx, JS_NewObject(cx, &BulkOps::klass));
+    if (!obj) return false;
+
+    return JS_DefineProperty(cx, global, "BulkOps", obj, JSPROP_ENUMERATE);
+  }
+};
+constexpr JSClassOps BulkOps::classOps;
+constexpr JSClass BulkOps::klass;
+constexpr BulkOps::LazyProperty BulkOps::lazyProperties[];
+
+static const char* testProgram = R"js(
+  const x = new Float32Array([1, 2, 3, 4]);
+  const y = new Float32Array([10, 20, 30, 40]);
+  BulkOps.saxpy(2, x, y);  // y = [12, 24, 36, 48]
+
+  const u = new Uint32Array([0x11223344]);
+  BulkOps.byteswap(u);  // u = [0x44332211]
+
+  const bytes = new Uint8Array([9, 8, 7, 6]);
+  [BulkOps.sum(y), BulkOps.min(y), BulkOps.max(y),
+   u[0].toString(16), BulkOps.scan(bytes, 7)].join(' ');
+)js";
+
+/**** BOILERPLATE *************************************************************/
+// Below here, the code is very similar to what is found in resolve.cpp
+
+static bool ExecuteCodePrintResult(JSContext* cx, const char* code) {
+  JS::CompileOptions options(cx);
+  options.setFileAndLine("noname", 1);
+
+  JS::SourceText<mozilla::Utf8Unit> source;
+  if (!source.init(cx, code, strlen(code), JS::SourceOwnership::Borrowed)) {
+    return false;
+  }
+
+  JS::RootedValue rval(cx);
+  if (!JS::Evaluate(cx, options, source, &rval)) return false;
+
+  JS::RootedString rval_str(cx, JS::ToString(cx, rval));
+  if (!rval_str) return false;
+
+  std::cout << JS_EncodeStringToASCII(cx, rval_str).get() << '\n';
+  return true;
+}
+
+static bool BulkOpsExample(JSContext* cx) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) {
+    return false;
+  }
+
+  JSAutoRealm ar(cx, global);
+
+  if (!BulkOps::Define(cx)) {
+    boilerplate::ReportAndClearException(cx);
+    return false;
+  }
+
+  if (!ExecuteCodePrintResult(cx, testProgram)) {
+    boilerplate::ReportAndClearException(cx);
+    return false;
+  }
+
+  return true;
+}
+
+int main(int argc, const char* argv[]) {
+  if (!boilerplate::RunExample(BulkOpsExample)) return 1;
+  return 0;
+}
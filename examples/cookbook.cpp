@@ -1,12 +1,19 @@
 #include <cassert>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <map>
+#include <string>
+#include <vector>
 
 #include <jsapi.h>
 #include "js/Object.h"
+#include "js/experimental/TypedData.h"
 
 #include <mozilla/Unused.h>
 
 #include <js/Array.h>
+#include <js/BigInt.h>
 #include <js/CompilationAndEvaluation.h>
 #include <js/Conversions.h>
 #include <js/Initialization.h>
@@ -247,6 +254,128 @@ static bool PersonConstructor(JSContext* cx, unsigned argc, JS::Value* vp) {
   return true;
 }
 
+///// Recycling short-lived record objects through a pool //////////////////////
+
+/* Workloads that construct a fresh record object per event pay a nursery
+ * allocation and a shape lookup each time, and the dead records are what the
+ * nursery then spends its time evacuating. If the records have a fixed set
+ * of properties, the objects can be recycled instead: a released object goes
+ * on a freelist and the next acquire resets its slots in place. Recycled
+ * objects survive minor GCs and get tenured, so the steady-state allocation
+ * rate drops to the pool's miss rate.
+ *
+ * The freelist lives in a traced container (the SafeBox pattern from
+ * tracing.cpp: a struct with a trace() method holding JS::Heap fields), so
+ * pooled objects stay alive and their pointers stay current across moving
+ * GC. Every pooled object is created from the same code path with the same
+ * property order, which keeps them all on one shape. */
+class PersonPool {
+  struct Roots {
+    std::vector<JS::Heap<JSObject*>> freeList;
+
+    void trace(JSTracer* trc) {
+      for (auto& obj : freeList) {
+        JS::TraceEdge(trc, &obj, "PersonPool freelist entry");
+      }
+    }
+  };
+
+  JS::PersistentRooted<Roots> m_roots;
+  size_t m_hits = 0;
+  size_t m_misses = 0;
+
+  // All pooled objects come through here so they share one shape.
+  JSObject* allocate(JSContext* cx) {
+    JS::RootedObject obj(cx, JS_NewPlainObject(cx));
+    if (!obj) return nullptr;
+    JS::RootedValue undef(cx);
+    if (!JS_SetProperty(cx, obj, "name", undef) ||
+        !JS_SetProperty(cx, obj, "age", undef))
+      return nullptr;
+    return obj;
+  }
+
+  bool setSlots(JSContext* cx, JS::HandleObject obj, JS::HandleValue name,
+                JS::HandleValue age) {
+    return JS_SetProperty(cx, obj, "name", name) &&
+           JS_SetProperty(cx, obj, "age", age);
+  }
+
+ public:
+  bool init(JSContext* cx) {
+    m_roots.init(cx);
+    return true;
+  }
+
+  // PersistentRooted must be dropped before the context is destroyed.
+  void reset(void) { m_roots.reset(); }
+
+  // Pop a recycled object and reset its slots, or allocate on a miss.
+  JSObject* Acquire(JSContext* cx, JS::HandleValue name, JS::HandleValue age) {
+    JS::RootedObject obj(cx);
+
+    auto& freeList = m_roots.get().freeList;
+    if (!freeList.empty()) {
+      obj = freeList.back();
+      freeList.pop_back();
+      m_hits++;
+    } else {
+      obj = allocate(cx);
+      if (!obj) return nullptr;
+      m_misses++;
+    }
+
+    if (!setSlots(cx, obj, name, age)) return nullptr;
+    return obj;
+  }
+
+  // Hand an object back for reuse. Only objects that came from Acquire (and
+  // that no JS code still references) should be released; the slots are
+  // cleared so the pool doesn't keep old property values alive.
+  bool Release(JSContext* cx, JS::HandleObject obj) {
+    JS::RootedValue undef(cx);
+    if (!JS_SetProperty(cx, obj, "name", undef) ||
+        !JS_SetProperty(cx, obj, "age", undef))
+      return false;
+    m_roots.get().freeList.emplace_back(obj);
+    return true;
+  }
+
+  struct Stats {
+    size_t hits;    // acquires served from the freelist
+    size_t misses;  // acquires that had to allocate
+    size_t pooled;  // objects currently on the freelist
+  };
+  Stats GetStats(void) const {
+    return {m_hits, m_misses, m_roots.get().freeList.size()};
+  }
+};
+
+static PersonPool personPool;
+
+static bool ConstructPooledObjects(JSContext* cx) {
+  JS::RootedString name_str(cx, JS_NewStringCopyZ(cx, "Dave"));
+  if (!name_str) return false;
+  JS::RootedValue name(cx, JS::StringValue(name_str));
+  JS::RootedValue age(cx, JS::Int32Value(24));
+
+  // First acquire allocates; after a release, the next one is a freelist pop
+  // plus two slot writes.
+  JS::RootedObject person(cx, personPool.Acquire(cx, name, age));
+  if (!person) return false;
+  if (!personPool.Release(cx, person)) return false;
+
+  person = personPool.Acquire(cx, name, age);
+  if (!person) return false;
+  if (!personPool.Release(cx, person)) return false;
+
+  PersonPool::Stats stats = personPool.GetStats();
+  assert(stats.hits == 1 && stats.misses == 1 && stats.pooled == 1);
+  mozilla::Unused << stats;
+
+  return true;
+}
+
 ///// Calling a global JS function /////////////////////////////////////////////
 
 /* // JavaScript
@@ -306,6 +435,185 @@ static bool ReturnFloat(JSContext* cx, unsigned argc, JS::Value* vp) {
   return true;
 }
 
+///// Binding C++ functions without CallArgs plumbing //////////////////////////
+
+/* The natives above hand-write the JS::CallArgsFromVp / conversion / rval
+ * dance. For a native that is just a function of plain values, the
+ * boilerplate::Bind<&F> template generates all of that at compile time, with
+ * type-specialized fast paths (an int32_t parameter skips JS::ToInt32 when
+ * the value is already an int32, strings copy Latin-1 characters directly).
+ * The functions below go into globalFunctions via Bind; see boilerplate.h
+ * for what's supported.
+ */
+static int32_t AddIntegers(int32_t a, int32_t b) { return a + b; }
+
+static double MultiplyNumbers(double a, double b) { return a * b; }
+
+static std::string Greet(std::string name) { return "Hello, " + name; }
+
+///// Moving 64-bit integers without precision loss ////////////////////////////
+
+/* JS numbers are doubles: exact only up to 2^53, so marshaling 64-bit
+ * counters through setDouble/ToNumber silently corrupts large values, while
+ * always creating a BigInt allocates per value even for tiny ones. The
+ * helpers below pick the cheapest exact representation: int32 when it fits,
+ * a (still exact) double up to 2^53, a BigInt only beyond that.
+ */
+
+static bool SetUint64Result(JSContext* cx, JS::CallArgs& args,
+                            uint64_t value) {
+  if (value <= uint64_t(INT32_MAX)) {
+    args.rval().setInt32(int32_t(value));
+    return true;
+  }
+  if (value <= (uint64_t(1) << 53)) {
+    args.rval().setNumber(double(value));  // exact below 2^53
+    return true;
+  }
+
+  // Only here does the value need a BigInt. JS::NumberToBigInt would round
+  // through a double, so route through a one-element BigUint64Array: its
+  // element read materializes an exact BigInt.
+  JS::RootedObject scratch(cx, JS_NewBigUint64Array(cx, 1));
+  if (!scratch) return false;
+  {
+    bool isSharedMemory;
+    JS::AutoAssertNoGC nogc;
+    uint64_t* data = JS_GetBigUint64ArrayData(scratch, &isSharedMemory, nogc);
+    data[0] = value;
+  }
+  JS::RootedValue element(cx);
+  if (!JS_GetElement(cx, scratch, 0, &element)) return false;
+  args.rval().set(element);
+  return true;
+}
+
+/* The reverse direction, accepting whatever the script sends: an int32, an
+ * exactly-integral double, or a BigInt that fits in uint64. */
+static bool GetUint64Arg(JSContext* cx, JS::HandleValue v, uint64_t* out) {
+  if (v.isInt32()) {
+    int32_t i = v.toInt32();
+    if (i < 0) {
+      JS_ReportErrorASCII(cx, "expected a non-negative value");
+      return false;
+    }
+    *out = uint64_t(i);
+    return true;
+  }
+  if (v.isDouble()) {
+    double d = v.toDouble();
+    if (d < 0 || d != std::floor(d) || d > double(uint64_t(1) << 53)) {
+      JS_ReportErrorASCII(cx, "number is not an exact unsigned integer");
+      return false;
+    }
+    *out = uint64_t(d);
+    return true;
+  }
+  if (v.isBigInt()) {
+    if (!JS::BigIntIsUint64(v.toBigInt(), out)) {
+      JS_ReportErrorASCII(cx, "BigInt does not fit in 64 bits unsigned");
+      return false;
+    }
+    return true;
+  }
+  JS_ReportErrorASCII(cx, "expected a number or BigInt");
+  return false;
+}
+
+/* Some endpoints contractually return BigInt regardless of magnitude. Small
+ * counter values dominate in practice, so the first few BigInts are created
+ * once and reused from a traced cache instead of allocated per call. */
+static constexpr size_t kSmallBigInts = 64;
+
+struct BigIntCache {
+  std::vector<JS::Heap<JS::BigInt*>> small;
+
+  void trace(JSTracer* trc) {
+    for (auto& bi : small) {
+      JS::TraceEdge(trc, &bi, "cached small BigInt");
+    }
+  }
+};
+static JS::PersistentRooted<BigIntCache> bigIntCache;
+
+static bool SetUint64ResultBigInt(JSContext* cx, JS::CallArgs& args,
+                                  uint64_t value) {
+  if (value < kSmallBigInts) {
+    auto& small = bigIntCache.get().small;
+    if (small.empty()) small.resize(kSmallBigInts);
+    if (!small[value]) {
+      JS::BigInt* bi = JS::NumberToBigInt(cx, double(value));  // exact: small
+      if (!bi) return false;
+      small[value] = bi;
+    }
+    args.rval().setBigInt(small[value]);
+    return true;
+  }
+
+  if (value <= (uint64_t(1) << 53)) {
+    JS::BigInt* bi = JS::NumberToBigInt(cx, double(value));
+    if (!bi) return false;
+    args.rval().setBigInt(bi);
+    return true;
+  }
+
+  // Past 2^53 the generic path already produces an exact BigInt.
+  return SetUint64Result(cx, args, value);
+}
+
+/* Bulk path: a C++ span of counters becomes a BigUint64Array in one
+ * JS-to-native crossing -- one allocation and a memcpy, instead of one
+ * BigInt per element. */
+static JSObject* Uint64SpanToBigUint64Array(JSContext* cx,
+                                            const uint64_t* values,
+                                            size_t length) {
+  JS::RootedObject array(cx, JS_NewBigUint64Array(cx, length));
+  if (!array) return nullptr;
+  {
+    bool isSharedMemory;
+    JS::AutoAssertNoGC nogc;
+    uint64_t* data = JS_GetBigUint64ArrayData(array, &isSharedMemory, nogc);
+    memcpy(data, values, length * sizeof(uint64_t));
+  }
+  return array;
+}
+
+// Natives exercising the helpers, registered in globalFunctions below.
+static bool CounterValue(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  return SetUint64Result(cx, args, (uint64_t(1) << 60) + 5);
+}
+
+static bool CounterBigInt(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  return SetUint64ResultBigInt(cx, args, 7);
+}
+
+static bool RecordCounter(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  if (!args.requireAtLeast(cx, "recordCounter", 1)) return false;
+
+  uint64_t value;
+  if (!GetUint64Arg(cx, args[0], &value)) return false;
+  mozilla::Unused << value;
+
+  args.rval().setUndefined();
+  return true;
+}
+
+static bool CounterArray(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+
+  static const uint64_t counters[] = {1, 42, (uint64_t(1) << 54) + 3,
+                                      ~uint64_t(0)};
+  JSObject* array = Uint64SpanToBigUint64Array(
+      cx, counters, sizeof(counters) / sizeof(counters[0]));
+  if (!array) return false;
+
+  args.rval().setObject(*array);
+  return true;
+}
+
 /**** EXCEPTION HANDLING ******************************************************/
 
 ///// `throw` //////////////////////////////////////////////////////////////////
@@ -563,6 +871,81 @@ static bool CheckProperty(JSContext* cx, JS::HandleValue y) {
   return true;
 }
 
+///// Interned property keys ///////////////////////////////////////////////////
+
+/* Each of the helpers above names its property with a C string, which makes
+ * the engine atomize "myprop" on every call. For property accesses on a hot
+ * path, intern the name once into a jsid at startup and use the *ById entry
+ * points; the repeated atom-table lookups disappear from the profile.
+ *
+ * The atom is pinned, so it stays alive for the process; the PersistentRooted
+ * keeps the id itself valid across GCs and must be reset before shutdown
+ * (see the note in tracing.cpp about global PersistentRooteds).
+ */
+struct PropertyKeyCache {
+  JS::PersistentRooted<jsid> myprop;
+
+  bool init(JSContext* cx) {
+    JS::RootedString str(cx, JS_AtomizeAndPinString(cx, "myprop"));
+    if (!str) return false;
+
+    JS::RootedId id(cx);
+    if (!JS_StringToId(cx, str, &id)) return false;
+
+    myprop.init(cx, id);
+    return true;
+  }
+
+  void reset(void) { myprop.reset(); }
+};
+static PropertyKeyCache propertyKeys;
+
+/* // JavaScript
+ * var x = y.myprop;   // as GetProperty, but no per-call atomization
+ */
+static bool GetPropertyById(JSContext* cx, JS::HandleValue y) {
+  JS::RootedValue x(cx);
+
+  assert(y.isObject());
+  JS::RootedObject yobj(cx, &y.toObject());
+  if (!JS_GetPropertyById(cx, yobj, propertyKeys.myprop, &x)) return false;
+
+  return true;
+}
+
+/* // JavaScript
+ * y.myprop = x;   // as SetProperty, but no per-call atomization
+ */
+static bool SetPropertyById(JSContext* cx, JS::HandleValue y,
+                            JS::HandleValue x) {
+  JS::RootedObject yobj(cx);
+  if (!JS_ValueToObject(cx, y, &yobj)) return false;
+  if (!JS_SetPropertyById(cx, yobj, propertyKeys.myprop, x)) return false;
+
+  return true;
+}
+
+/* // JavaScript
+ * if ("myprop" in y) { ... }   // as CheckProperty, but no per-call
+ *                              // atomization
+ */
+static bool CheckPropertyById(JSContext* cx, JS::HandleValue y) {
+  bool found;
+
+  if (!y.isObject()) {
+    found = false;
+  } else {
+    JS::RootedObject yobj(cx, &y.toObject());
+    if (!JS_HasPropertyById(cx, yobj, propertyKeys.myprop, &found))
+      return false;
+  }
+  if (found) {
+    // then do something
+  }
+
+  return true;
+}
+
 ///// Defining a constant property /////////////////////////////////////////////
 
 /* This is the first of three examples involving the built-in function
@@ -747,16 +1130,27 @@ static bool MyClassPropGetter(JSContext* cx, unsigned argc, JS::Value* vp) {
   return true;
 }
 
+// Scratch slots for values rooted inside hot native calls. Borrowing a slot
+// is a freelist pop; the GC registration happened once, at init. See the
+// ScratchRootPool docs in boilerplate.h.
+static boilerplate::ScratchRootPool scratchRoots;
+
 static bool MyClassMethod(JSContext* cx, unsigned argc, JS::Value* vp) {
   JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
   JS::RootedObject thisObj(cx);
   if (!args.computeThis(cx, &thisObj)) return false;
 
-  JS::RootedValue v_a(cx, JS::GetReservedSlot(thisObj, SlotA));
-  JS::RootedValue v_b(cx, JS::GetReservedSlot(thisObj, SlotB));
+  // Instead of pushing two JS::RootedValues onto the rooting stack each call,
+  // borrow pre-rooted slots from the scratch pool.
+  auto v_a = scratchRoots.borrow();
+  auto v_b = scratchRoots.borrow();
+  v_a.set(JS::GetReservedSlot(thisObj, SlotA));
+  v_b.set(JS::GetReservedSlot(thisObj, SlotB));
 
   double a, b;
-  if (!JS::ToNumber(cx, v_a, &a) || !JS::ToNumber(cx, v_b, &b)) return false;
+  if (!JS::ToNumber(cx, v_a.handle(), &a) ||
+      !JS::ToNumber(cx, v_b.handle(), &b))
+    return false;
 
   args.rval().setDouble(a + b);
   return true;
@@ -839,6 +1233,38 @@ static bool DefineMyClass(JSContext* cx, JS::HandleObject global) {
   return true;
 }
 
+///// Installing classes on fresh globals without re-parsing specs /////////////
+
+/* JS_InitClass above re-parses the spec tables and re-atomizes every name
+ * each time it runs. An embedding that creates a fresh global per request
+ * pays that on every request; the class-registration cache in boilerplate
+ * does the atomization once and replays the definitions with interned ids.
+ * The tables below mirror the JS_FN/JS_PSG spec arrays above, in the
+ * registry's (null-name-terminated) format. */
+
+static const boilerplate::ClassMethod myClassRegistryMethods[] = {
+    {"method", MyClassMethod, 0}, {nullptr}};
+
+static const boilerplate::ClassGetter myClassRegistryProperties[] = {
+    {"prop", MyClassPropGetter}, {nullptr}};
+
+static const boilerplate::ClassMethod myClassRegistryStaticMethods[] = {
+    {"static_method", MyClassStaticMethod, 2}, {nullptr}};
+
+static const boilerplate::ClassGetter myClassRegistryStaticProperties[] = {
+    {"static_prop", MyClassStaticPropGetter}, {nullptr}};
+
+static bool RegisterMyClass(JSContext* cx) {
+  boilerplate::ClassSpec spec = {&myClass,
+                                 MyClassConstructor,
+                                 2,
+                                 myClassRegistryMethods,
+                                 myClassRegistryProperties,
+                                 myClassRegistryStaticMethods,
+                                 myClassRegistryStaticProperties};
+  return boilerplate::RegisterClass(cx, spec);
+}
+
 /**** WANTED ******************************************************************/
 
 /* Simulating `for` and `for...of`.
@@ -861,14 +1287,34 @@ static bool ThrowJSNative(JSContext* cx, unsigned argc, JS::Value* vp) {
   return THROW_ERROR(cx, global, "Error message");
 }
 
+// Perf counters for a few of the natives below; registering through
+// boilerplate::Counted costs one branch per call while counters are off and
+// attributes calls/cycles/argument types per binding when they're on.
+static boilerplate::PerfCounter returnIntegerCounter("returnInteger");
+static boilerplate::PerfCounter returnFloatCounter("returnFloat");
+static boilerplate::PerfCounter addIntegersCounter("addIntegers");
+
 static JSFunctionSpec globalFunctions[] = {
     JS_FN("findGlobalObject", FindGlobalObject, 0, 0),
     JS_FN("Person", PersonConstructor, 2, JSFUN_CONSTRUCTOR),
     JS_FN("foo", GenericJSNative, 0, 0),
-    JS_FN("returnInteger", ReturnInteger, 0, 0),
-    JS_FN("returnFloat", ReturnFloat, 0, 0),
+    JS_FN("returnInteger",
+          (boilerplate::Counted<ReturnInteger, &returnIntegerCounter>), 0, 0),
+    JS_FN("returnFloat",
+          (boilerplate::Counted<ReturnFloat, &returnFloatCounter>), 0, 0),
+    JS_FN("addIntegers",
+          (boilerplate::Counted<boilerplate::Bind<&AddIntegers>,
+                                &addIntegersCounter>),
+          2, 0),
+    JS_FN("multiplyNumbers", boilerplate::Bind<&MultiplyNumbers>, 2, 0),
+    JS_FN("greet", boilerplate::Bind<&Greet>, 1, 0),
     JS_FN("bar", ThrowJSNative, 0, 0),
     JS_FN("cleanup", GenericJSNative, 0, 0),
+    JS_FN("dumpPerfCounters", boilerplate::DumpPerfCounters, 0, 0),
+    JS_FN("counterValue", CounterValue, 0, 0),
+    JS_FN("counterBigInt", CounterBigInt, 0, 0),
+    JS_FN("recordCounter", RecordCounter, 1, 0),
+    JS_FN("counterArray", CounterArray, 0, 0),
     JS_FS_END};
 
 static bool ExecuteCode(JSContext* cx, const char* code) {
@@ -884,6 +1330,87 @@ static bool ExecuteCode(JSContext* cx, const char* code) {
   return JS::Evaluate(cx, options, source, &unused);
 }
 
+/* Variant of ExecuteCode for snippets that run many times: the source is
+ * compiled once into a PersistentRooted script keyed by source identity, and
+ * re-executions skip the parser entirely. Compilation costs on the order of
+ * 100x an execution for a small snippet, so this is the difference between a
+ * rule engine that parses per request and one that doesn't.
+ *
+ * JS::CloneAndExecuteScript rather than JS_ExecuteScript, so a script
+ * compiled under one global can be run against a different (e.g. fresh
+ * per-request) global; for same-realm reruns the clone is a no-op.
+ *
+ * Each entry also counts its executions. The engine's own warm-up counters
+ * decide when a script tiers up to the Baseline and optimizing JITs, but
+ * they are not readable from the API; keeping our own count alongside the
+ * cache lets ReportCachedScriptTiers below infer the tier from the same
+ * thresholds (see boilerplate::PredictedJitTier and JitTierConfig for how
+ * to lower them so cached scripts tier up within a run). */
+struct CachedScript {
+  JS::PersistentRooted<JSScript*> script;
+  uint64_t runs = 0;
+};
+static std::map<std::string, CachedScript> scriptCache;
+
+static bool ExecuteCodeCached(JSContext* cx, const char* code) {
+  JS::RootedScript script(cx);
+
+  auto cached = scriptCache.find(code);
+  if (cached != scriptCache.end()) {
+    script = cached->second.script;
+    cached->second.runs++;
+  } else {
+    JS::CompileOptions options(cx);
+    options.setFileAndLine("noname", 1);
+
+    /* A cached script's inner functions will run too, so parse them fully
+     * up front rather than leaving lazy stubs to be reparsed on first
+     * call. */
+    options.setForceFullParse();
+
+    JS::SourceText<mozilla::Utf8Unit> source;
+    if (!source.init(cx, code, strlen(code), JS::SourceOwnership::Borrowed)) {
+      return false;
+    }
+
+    script = JS::Compile(cx, options, source);
+    if (!script) return false;
+
+    CachedScript& entry = scriptCache[code];
+    entry.script.init(cx, script);
+    entry.runs = 1;
+  }
+
+  JS::RootedValue unused(cx);
+  return JS::CloneAndExecuteScript(cx, script, &unused);
+}
+
+/* Report the JIT tier each cached script has reached under the warm-up
+ * triggers currently in effect. With default triggers a script run only a
+ * handful of times stays in the interpreter; rerun with JIT_FORCE_FULL=1
+ * (or low JIT_BASELINE_WARMUP / JIT_ION_WARMUP values) to see the cached
+ * snippets tier up from their first execution. */
+static void ReportCachedScriptTiers(JSContext* cx) {
+  for (const auto& entry : scriptCache) {
+    // Label each script by its first non-blank source line.
+    size_t begin = entry.first.find_first_not_of(" \n");
+    if (begin == std::string::npos) begin = 0;
+    std::string label =
+        entry.first.substr(begin, entry.first.find('\n', begin) - begin);
+    std::cout << "cached script \"" << label << "...\": " << entry.second.runs
+              << " run(s), tier "
+              << boilerplate::PredictedJitTier(cx, entry.second.runs) << '\n';
+  }
+}
+
+/* The cache holds PersistentRooted scripts, which must be dropped before the
+ * JS engine shuts down; keep one of these on the stack for the lifetime of
+ * the task. */
+class AutoClearScriptCache {
+ public:
+  ~AutoClearScriptCache(void) { scriptCache.clear(); }
+};
+
 class AutoReportException {
   JSContext* m_cx;
 
@@ -909,6 +1436,117 @@ class AutoReportException {
   }
 };
 
+///// Tenant realms in a shared compartment ////////////////////////////////////
+
+/* Two tenant globals sharing one compartment hand objects straight to each
+ * other: same-compartment realms interact without cross-compartment
+ * wrappers, so tenant B calls a function created in tenant A's realm
+ * directly. The trade is joint teardown -- the tenants can only be
+ * reclaimed as a group, which TeardownAll does with one shrinking GC. */
+static bool ShareCompartmentAcrossTenants(JSContext* cx) {
+  boilerplate::TenantRealms tenants;
+  if (!tenants.init(cx)) return false;
+
+  {
+    /* The first tenant opens the compartment; the second joins it. */
+    JS::RootedObject tenantA(cx, tenants.CreateTenantGlobal(cx));
+    if (!tenantA) return false;
+    JS::RootedObject tenantB(cx, tenants.CreateTenantGlobal(cx));
+    if (!tenantB) return false;
+    assert(tenants.Count() == 2);
+
+    {
+      JSAutoRealm realmA(cx, tenantA);
+      if (!ExecuteCode(cx, "function whoAmI() { return 'tenant A'; }"))
+        return false;
+    }
+
+    /* Fetch the function from tenant A and call it from tenant B. In
+     * separate compartments this handoff would need JS_WrapValue; here the
+     * value crosses as-is. The call still runs in the function's own realm,
+     * so it sees tenant A's global. */
+    JS::RootedValue whoAmI(cx);
+    {
+      JSAutoRealm realmA(cx, tenantA);
+      if (!JS_GetProperty(cx, tenantA, "whoAmI", &whoAmI)) return false;
+    }
+
+    JSAutoRealm realmB(cx, tenantB);
+    JS::RootedValue rval(cx);
+    if (!JS_CallFunctionValue(cx, nullptr, whoAmI,
+                              JS::HandleValueArray::empty(), &rval)) {
+      return false;
+    }
+
+    bool match = false;
+    if (!rval.isString() ||
+        !JS_StringEqualsAscii(cx, rval.toString(), "tenant A", &match) ||
+        !match) {
+      return false;
+    }
+  }
+
+  /* With the stack roots gone, the traced container is all that keeps the
+   * tenants alive; dropping the group reclaims the compartment in one
+   * sweep. */
+  tenants.TeardownAll(cx);
+  assert(tenants.Count() == 0);
+  tenants.reset();
+  return true;
+}
+
+///// Fast error capture ///////////////////////////////////////////////////////
+
+/* Exercise the boilerplate error ring with the awkward shapes it has to
+ * handle: an Error object (whose attached JSErrorReport the capture copies
+ * straight out), a thrown Latin-1 string, a thrown two-byte string (which
+ * gets a placeholder rather than a transcode), and a thrown number. Then
+ * overflow the ring without draining it and check the dropped-entry
+ * accounting. */
+static bool CaptureErrorsIntoRing(JSContext* cx) {
+  static const char* throwers[] = {
+      "throw new Error('boom');",
+      "throw 'plain string';",
+      "throw '\\u2603';",  // two-byte: capture stores a placeholder
+      "throw 42;",
+  };
+
+  for (const char* thrower : throwers) {
+    if (ExecuteCode(cx, thrower)) return false;  // must have thrown
+    if (!boilerplate::CaptureError(cx)) return false;
+  }
+  assert(!JS_IsExceptionPending(cx));  // capture steals the exception
+
+  boilerplate::CapturedError entries[8];
+  size_t count = boilerplate::TakeCapturedErrors(entries, 8);
+  assert(count == 4);
+  assert(strstr(entries[0].message, "boom") && entries[0].lineno == 1);
+  assert(strcmp(entries[1].message, "plain string") == 0);
+  assert(strcmp(entries[2].message, "[non-Latin-1 exception string]") == 0);
+  assert(strcmp(entries[3].message, "[non-Error exception thrown]") == 0);
+  mozilla::Unused << count;
+
+  /* Overflow: capture more errors than the ring holds, drain what survived,
+   * and the dropped counter accounts for exactly the rest. */
+  uint64_t droppedBefore = boilerplate::CapturedErrorsDropped();
+  const unsigned overflow = 70;
+  for (unsigned i = 0; i < overflow; i++) {
+    if (ExecuteCode(cx, "throw 'again';")) return false;
+    if (!boilerplate::CaptureError(cx)) return false;
+  }
+
+  size_t drained = 0;
+  while ((count = boilerplate::TakeCapturedErrors(entries, 8)) > 0) {
+    drained += count;
+  }
+  assert(boilerplate::CapturedErrorsDropped() - droppedBefore ==
+         overflow - drained);
+  mozilla::Unused << drained;
+  mozilla::Unused << droppedBefore;
+
+  return true;
+}
+
 /* Execute each of the examples; many don't do anything but it's good to be able
  * to exercise the code to make sure it hasn't bitrotted. */
 static bool RunCookbook(JSContext* cx) {
@@ -921,6 +1559,10 @@ static bool RunCookbook(JSContext* cx) {
   if (!JS_DefineFunctions(cx, global, globalFunctions)) return false;
 
   AutoReportException autoreport(cx);
+  AutoClearScriptCache autoClearScripts;
+
+  boilerplate::SetPerfCountersEnabled(true);
+  bigIntCache.init(cx);
 
   // Execute each of the JSAPI recipe functions we defined:
 
@@ -934,6 +1576,9 @@ static bool RunCookbook(JSContext* cx) {
     return false;
   }
 
+  if (!personPool.init(cx)) return false;
+  if (!ConstructPooledObjects(cx)) return false;
+
   JS::RootedValue f(cx);
   JSFunction* newFunction = JS_NewFunction(cx, JustForFun, 0, 0, "f");
   if (!newFunction) return false;
@@ -967,11 +1612,17 @@ static bool RunCookbook(JSContext* cx) {
   if (!CheckProperty(cx, v_obj)) return false;
   if (!GetProperty(cx, v_obj)) return false;
   if (!GetPropertySafe(cx, global, v_obj)) return false;
+  if (!propertyKeys.init(cx)) return false;
+  if (!SetPropertyById(cx, v_obj, v_prop)) return false;
+  if (!CheckPropertyById(cx, v_obj)) return false;
+  if (!GetPropertyById(cx, v_obj)) return false;
+  propertyKeys.reset();
   if (!DefineConstantProperty(cx, obj)) return false;
   if (!DefineGetterSetterProperty(cx, obj)) return false;
   if (!DefineReadOnlyProperty(cx, obj)) return false;
   if (!ModifyStringPrototype(cx, global)) return false;
 
+  if (!scratchRoots.init(cx, 8)) return false;
   if (!DefineMyClass(cx, global)) return false;
   if (!ExecuteCode(cx, R"js(
         const m = new MyClass(1, 2);
@@ -982,14 +1633,56 @@ static bool RunCookbook(JSContext* cx) {
       )js"))
     return false;
 
-  // Also execute each of the JSNative functions we defined:
-  return ExecuteCode(cx, R"js(
+  // Equip a second, fresh global from the class registry: same class, but
+  // installed by replaying interned-id definitions rather than another
+  // JS_InitClass pass over the spec tables.
+  if (!RegisterMyClass(cx)) return false;
+  {
+    JS::RootedObject tenantGlobal(cx, boilerplate::CreateGlobal(cx));
+    if (!tenantGlobal) return false;
+    JSAutoRealm tenant(cx, tenantGlobal);
+    if (!boilerplate::InstallClasses(cx, tenantGlobal)) return false;
+    if (!ExecuteCode(cx, R"js(
+          const t = new MyClass(3, 4);
+          t.method();
+          MyClass.static_method(4, 5);
+        )js"))
+      return false;
+  }
+
+  if (!ShareCompartmentAcrossTenants(cx)) return false;
+  if (!CaptureErrorsIntoRing(cx)) return false;
+
+  // Also execute each of the JSNative functions we defined. This goes through
+  // the script cache: the first call compiles, the second re-executes the
+  // cached bytecode without reparsing.
+  static const char* nativesSnippet = R"js(
     justForFun();
     findGlobalObject();
     returnInteger();
     returnFloat();
+    addIntegers(1, 2);
+    multiplyNumbers(1.5, 2);
+    greet('world');
+    dumpPerfCounters();
+    counterValue() === 2n ** 60n + 5n;
+    counterBigInt() === 7n;
+    recordCounter(42);
+    recordCounter(2n ** 60n);
+    counterArray()[3] === 2n ** 64n - 1n;
     ''.md5sum
-  )js");
+  )js";
+  if (!ExecuteCodeCached(cx, nativesSnippet)) return false;
+  if (!ExecuteCodeCached(cx, nativesSnippet)) return false;
+
+  ReportCachedScriptTiers(cx);
+
+  // The scratch pool, object pool and BigInt cache hold PersistentRooteds;
+  // drop them before the context goes away.
+  scratchRoots.reset();
+  personPool.reset();
+  bigIntCache.reset();
+  return true;
 }
 
 int main(int argc, const char* argv[]) {
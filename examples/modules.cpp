@@ -1,11 +1,26 @@
+#include <condition_variable>
+#include <cstdio>
 #include <map>
+#include <mutex>
 #include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <jsapi.h>
 
+#include <mozilla/RefPtr.h>
+
 #include <js/CompilationAndEvaluation.h>
 #include <js/Modules.h>
+#include <js/OffThreadScriptCompilation.h>
+#include <js/Realm.h>
 #include <js/SourceText.h>
+#include <js/Transcoding.h>
+#include <js/experimental/JSStencil.h>
 
 #include "boilerplate.h"
 
@@ -14,33 +29,527 @@
 // See 'boilerplate.cpp' for the parts of this example that are reused in many
 // simple embedding examples.
 
+// Modules are compiled to a stencil and the stencil is serialized with XDR to
+// an on-disk cache, keyed by a hash of the module source. Subsequent runs
+// decode the cached bytecode instead of re-parsing the source, which is a big
+// startup win for embeddings with large module graphs.
+//
+// The cache directory can be overridden with the MODULE_CACHE_DIR environment
+// variable; by default a '.module-cache' directory is created in the current
+// working directory.
+
+static std::string ModuleCacheDir(void) {
+  if (const char* dir = getenv("MODULE_CACHE_DIR")) return dir;
+  return ".module-cache";
+}
+
+// A simple FNV-1a hash is plenty here: the key only has to distinguish the
+// sources we wrote to the cache ourselves, and a corrupt or colliding entry
+// merely falls back to compilation.
+static uint64_t HashSource(const char* code, size_t length) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= uint8_t(code[i]);
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+static std::string ModuleCachePath(uint64_t key) {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.xdr", (unsigned long long)key);
+  return ModuleCacheDir() + "/" + name;
+}
+
+static bool ReadCacheFile(const std::string& path,
+                          JS::TranscodeBuffer& buffer) {
+  FILE* fp = fopen(path.c_str(), "rb");
+  if (!fp) return false;
+
+  fseek(fp, 0, SEEK_END);
+  long length = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  bool ok = false;
+  if (length > 0 && buffer.growByUninitialized(size_t(length))) {
+    ok = fread(buffer.begin(), 1, size_t(length), fp) == size_t(length);
+  }
+  fclose(fp);
+  return ok;
+}
+
+static void WriteCacheFile(const std::string& path,
+                           const JS::TranscodeBuffer& buffer) {
+  // Populating the cache is strictly best-effort; if anything fails we just
+  // compile from source again on the next run.
+  mkdir(ModuleCacheDir().c_str(), 0755);
+
+  // Write to a temporary file and rename so concurrent processes never
+  // observe a partially-written entry.
+  std::string tmp = path + ".tmp";
+  FILE* fp = fopen(tmp.c_str(), "wb");
+  if (!fp) return;
+
+  bool ok = fwrite(buffer.begin(), 1, buffer.length(), fp) == buffer.length();
+  fclose(fp);
+
+  if (ok)
+    rename(tmp.c_str(), path.c_str());
+  else
+    remove(tmp.c_str());
+}
+
+// Try to reconstruct a compiled module from the bytecode cache. Returns
+// nullptr on a cache miss or on a stale/corrupt entry, in which case the
+// caller compiles from source.
+static JSObject* DecodeCachedModule(JSContext* cx,
+                                    const JS::ReadOnlyCompileOptions& options,
+                                    const std::string& path) {
+  JS::TranscodeBuffer cached;
+  if (!ReadCacheFile(path, cached)) return nullptr;
+
+  JS::TranscodeRange range(cached.begin(), cached.length());
+  RefPtr<JS::Stencil> stencil;
+  if (JS::DecodeStencil(cx, options, range, stencil) !=
+      JS::TranscodeResult::Ok) {
+    // A mismatched engine version or truncated file is not an error; treat it
+    // as a miss and let compilation repopulate the entry.
+    JS_ClearPendingException(cx);
+    return nullptr;
+  }
+
+  return JS::InstantiateModuleStencil(cx, options, stencil);
+}
+
+// The import graph this example provides. A real embedding would discover
+// specifiers by scanning module sources (or a build manifest) rather than
+// hardcoding them, but the table is what lets us start compiling the whole
+// graph before the first import is resolved.
+struct ExampleModuleSource {
+  const char* filename;
+  const char* code;
+};
+
+// Module 'b': a generated source comfortably past the engine's off-thread
+// size gate (tiny sources are refused because the thread handoff costs more
+// than the parse), so the off-thread compilation pool below has something
+// real to chew on. C2 ends up as 1 + 2 + ... + 199 = 19900.
+static const char* BigModuleSource(void) {
+  static const std::string source = [] {
+    std::string code = "export function f0(x) { return x; }\n";
+    for (int i = 1; i < 200; i++) {
+      char line[80];
+      snprintf(line, sizeof(line),
+               "export function f%d(x) { return f%d(x) + %d; }\n", i, i - 1,
+               i);
+      code += line;
+    }
+    code += "export const C2 = f199(0);\n";
+    return code;
+  }();
+  return source.c_str();
+}
+
+static const std::map<std::u16string, ExampleModuleSource> moduleSources = {
+    {u"a", {"a", "export const C1 = 1;"}},
+    {u"b", {"b", BigModuleSource()}},
+};
+
+// A shared, read-only store of XDR'd stencils, memory-mapped by every worker
+// process. The first worker to start compiles the whole module graph and
+// writes the store; workers that fork or start later map the same file and
+// instantiate modules straight from the shared pages without ever touching
+// source or recompiling. Layout:
+//
+//   uint64 magic | uint64 count | count * { key, offset, length } | blobs
+//
+// Blob offsets are 8-byte aligned so the XDR decoder can read from the
+// mapping in place (the file itself is mapped page-aligned).
+class StencilStore {
+  struct Entry {
+    uint64_t key;
+    uint64_t offset;
+    uint64_t length;
+  };
+
+  static constexpr uint64_t MAGIC = 0x4d4f445354454e43;  // "MODSTENC"
+
+  const uint8_t* m_data = nullptr;
+  size_t m_length = 0;
+
+  static std::string StorePath(void) {
+    return ModuleCacheDir() + "/stencils.store";
+  }
+
+  const Entry* entries(void) const {
+    return reinterpret_cast<const Entry*>(m_data + 2 * sizeof(uint64_t));
+  }
+
+  uint64_t count(void) const {
+    return reinterpret_cast<const uint64_t*>(m_data)[1];
+  }
+
+ public:
+  // Map the store read-only. The mapping stays alive for the process
+  // lifetime: decoded stencils may reference the transcode bytes in place.
+  bool Open(void) {
+    int fd = open(StorePath().c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || size_t(sb.st_size) < 2 * sizeof(uint64_t)) {
+      close(fd);
+      return false;
+    }
+
+    void* data =
+        mmap(nullptr, size_t(sb.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+
+    m_data = static_cast<const uint8_t*>(data);
+    m_length = size_t(sb.st_size);
+
+    if (reinterpret_cast<const uint64_t*>(m_data)[0] != MAGIC) {
+      munmap(const_cast<uint8_t*>(m_data), m_length);
+      m_data = nullptr;
+      return false;
+    }
+    return true;
+  }
+
+  bool IsOpen(void) const { return m_data != nullptr; }
+
+  // Look up the XDR bytes for a source-hash key. The returned range points
+  // into the shared mapping; no copy is made.
+  bool Lookup(uint64_t key, JS::TranscodeRange* range) const {
+    if (!m_data) return false;
+    for (uint64_t i = 0; i < count(); i++) {
+      const Entry& e = entries()[i];
+      if (e.key == key && e.offset + e.length <= m_length) {
+        *range = JS::TranscodeRange(m_data + e.offset, size_t(e.length));
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Compile every known module to a stencil, XDR-encode it, and write the
+  // store. Written to a temporary file and renamed, so whichever of several
+  // racing workers wins, readers always see a complete store.
+  static bool Populate(JSContext* cx) {
+    std::vector<std::pair<uint64_t, JS::TranscodeBuffer>> blobs;
+
+    for (const auto& entry : moduleSources) {
+      const ExampleModuleSource& src = entry.second;
+      size_t length = strlen(src.code);
+
+      JS::CompileOptions options(cx);
+      options.setFileAndLine(src.filename, 1);
+
+      JS::SourceText<mozilla::Utf8Unit> source;
+      if (!source.init(cx, src.code, length, JS::SourceOwnership::Borrowed)) {
+        return false;
+      }
+
+      RefPtr<JS::Stencil> stencil =
+          JS::CompileModuleScriptToStencil(cx, options, source);
+      if (!stencil) return false;
+
+      JS::TranscodeBuffer buffer;
+      if (JS::EncodeStencil(cx, stencil, buffer) != JS::TranscodeResult::Ok) {
+        return false;
+      }
+      blobs.emplace_back(HashSource(src.code, length), std::move(buffer));
+    }
+
+    mkdir(ModuleCacheDir().c_str(), 0755);
+    std::string tmp = StorePath() + ".tmp";
+    FILE* fp = fopen(tmp.c_str(), "wb");
+    if (!fp) return false;
+
+    uint64_t header[2] = {MAGIC, blobs.size()};
+    uint64_t offset = 2 * sizeof(uint64_t) + blobs.size() * sizeof(Entry);
+
+    bool ok = fwrite(header, sizeof(header), 1, fp) == 1;
+    for (const auto& blob : blobs) {
+      offset = (offset + 7) & ~uint64_t(7);
+      Entry e = {blob.first, offset, blob.second.length()};
+      ok = ok && fwrite(&e, sizeof(e), 1, fp) == 1;
+      offset += blob.second.length();
+    }
+    for (const auto& blob : blobs) {
+      static const uint8_t padding[8] = {};
+      long pos = ftell(fp);
+      size_t pad = size_t(-pos & 7);
+      ok = ok && (pad == 0 || fwrite(padding, 1, pad, fp) == pad);
+      ok = ok && fwrite(blob.second.begin(), 1, blob.second.length(), fp) ==
+                     blob.second.length();
+    }
+    fclose(fp);
+
+    if (!ok) {
+      remove(tmp.c_str());
+      return false;
+    }
+    rename(tmp.c_str(), StorePath().c_str());
+    return true;
+  }
+};
+
+static StencilStore sharedStencils;
+
 // Translates source code into a JSObject representing the compiled module. This
-// module is not yet linked/instantiated.
-static JSObject* CompileExampleModule(JSContext* cx, const char* filename,
-                                      const char* code) {
+// module is not yet linked/instantiated. The caller keeps 'code' alive for the
+// duration of the call; it may point into a memory-mapped file.
+static JSObject* CompileModuleSource(JSContext* cx, const char* filename,
+                                     const char* code, size_t length) {
   JS::CompileOptions options(cx);
   options.setFileAndLine(filename, 1);
 
+  uint64_t key = HashSource(code, length);
+
+  // Fastest path: decode in place from the shared cross-process stencil
+  // store. The pages backing the XDR bytes are shared with every other worker
+  // on the machine.
+  JS::TranscodeRange sharedRange;
+  if (sharedStencils.Lookup(key, &sharedRange)) {
+    RefPtr<JS::Stencil> stencil;
+    if (JS::DecodeStencil(cx, options, sharedRange, stencil) ==
+        JS::TranscodeResult::Ok) {
+      return JS::InstantiateModuleStencil(cx, options, stencil);
+    }
+    JS_ClearPendingException(cx);
+  }
+
+  // Fast path: decode previously-cached bytecode instead of parsing.
+  if (JSObject* mod = DecodeCachedModule(cx, options, ModuleCachePath(key)))
+    return mod;
+
   JS::SourceText<mozilla::Utf8Unit> source;
-  if (!source.init(cx, code, strlen(code), JS::SourceOwnership::Borrowed)) {
+  if (!source.init(cx, code, length, JS::SourceOwnership::Borrowed)) {
     return nullptr;
   }
 
-  // Compile the module source to bytecode.
+  // Compile the module source to a stencil, the engine's context-free
+  // representation of compiled bytecode. The stencil is what gets serialized
+  // into the cache.
+  RefPtr<JS::Stencil> stencil =
+      JS::CompileModuleScriptToStencil(cx, options, source);
+  if (!stencil) return nullptr;
+
+  JS::TranscodeBuffer buffer;
+  if (JS::EncodeStencil(cx, stencil, buffer) == JS::TranscodeResult::Ok) {
+    WriteCacheFile(ModuleCachePath(key), buffer);
+  } else {
+    JS_ClearPendingException(cx);
+  }
+
+  // Realize the stencil as a module record in the current realm.
   //
   // NOTE: This generates a JSObject instead of a JSScript. This contains
   // additional metadata to resolve imports/exports. This object should not be
   // exposed to other JS code or unexpected behaviour may occur.
-  return JS::CompileModule(cx, options, source);
+  return JS::InstantiateModuleStencil(cx, options, stencil);
+}
+
+static JSObject* CompileExampleModule(JSContext* cx, const char* filename,
+                                      const char* code) {
+  return CompileModuleSource(cx, filename, code, strlen(code));
+}
+
+// Where file-backed modules live; a specifier 'foo' is looked up as
+// '<dir>/foo.mjs'. Overridable so the example can be pointed at a real module
+// tree without recompiling.
+static std::string ModuleSearchDir(void) {
+  if (const char* dir = getenv("MODULE_PATH")) return dir;
+  return "modules";
+}
+
+static std::string ModuleFilePath(const std::u16string& specifier) {
+  std::string path = ModuleSearchDir() + "/";
+  // Specifiers in this example are ASCII; a real loader would re-encode.
+  for (char16_t c : specifier) path += char(c);
+  return path + ".mjs";
+}
+
+// A module source memory-mapped from a file. Rather than copying the file
+// into a std::string and borrowing that temporary, we hand the mapped bytes
+// directly to JS::SourceText: the engine copies what it retains during
+// compilation, so the mapping only has to outlive the compile call, and the
+// kernel page cache shares the backing pages across every process loading the
+// same module.
+class MappedSource {
+  const char* m_data;
+  size_t m_length;
+
+  MappedSource(const char* data, size_t length)
+      : m_data(data), m_length(length) {}
+
+ public:
+  MappedSource(void) : m_data(nullptr), m_length(0) {}
+  MappedSource(MappedSource&& other)
+      : m_data(other.m_data), m_length(other.m_length) {
+    other.m_data = nullptr;
+    other.m_length = 0;
+  }
+  MappedSource(const MappedSource&) = delete;
+  MappedSource& operator=(const MappedSource&) = delete;
+
+  ~MappedSource(void) {
+    if (m_data) munmap(const_cast<char*>(m_data), m_length);
+  }
+
+  explicit operator bool(void) const { return m_data != nullptr; }
+  const char* data(void) const { return m_data; }
+  size_t length(void) const { return m_length; }
+
+  static MappedSource Map(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return MappedSource();
+
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || sb.st_size == 0) {
+      close(fd);
+      return MappedSource();
+    }
+
+    void* data = mmap(nullptr, size_t(sb.st_size), PROT_READ, MAP_PRIVATE, fd,
+                      0);
+    // The mapping keeps its own reference to the file; the descriptor is no
+    // longer needed either way.
+    close(fd);
+    if (data == MAP_FAILED) return MappedSource();
+
+    return MappedSource(static_cast<const char*>(data), size_t(sb.st_size));
+  }
+};
+
+// Load and compile a module from a file on disk, zero-copy: the mapped bytes
+// are borrowed by the compilation and unmapped when this returns. Returns
+// nullptr without a pending exception if no such file exists.
+static JSObject* CompileModuleFromFile(JSContext* cx,
+                                       const std::u16string& specifier) {
+  std::string path = ModuleFilePath(specifier);
+  MappedSource mapped = MappedSource::Map(path.c_str());
+  if (!mapped) return nullptr;
+
+  return CompileModuleSource(cx, path.c_str(), mapped.data(), mapped.length());
 }
 
 // Maintain a registry of imported modules. The ResolveHook may be called
 // multiple times for the same specifier and we need to return the same compiled
 // module.
 //
-// NOTE: This example assumes only one JSContext/GlobalObject is used, but in
-// general the registry needs to be distinct for each GlobalObject.
-static std::map<std::u16string, JS::PersistentRootedObject> moduleRegistry;
+// Module records belong to the realm they were instantiated in, so the
+// registry is stored in the realm private of each global rather than in a
+// process-wide table. This is the first tier of a two-tier design: per-global
+// module objects here, backed by the cross-process StencilStore below so that
+// a fresh global (or a fresh worker process) never recompiles source.
+struct ModuleRegistry {
+  std::map<std::u16string, JS::PersistentRootedObject> modules;
+};
+
+static ModuleRegistry* RegistryForCurrentRealm(JSContext* cx) {
+  JS::Realm* realm = JS::GetCurrentRealmOrNull(cx);
+  auto* registry = static_cast<ModuleRegistry*>(JS::GetRealmPrivate(realm));
+  if (!registry) {
+    registry = new ModuleRegistry();
+    JS::SetRealmPrivate(realm, registry);
+  }
+  return registry;
+}
+
+// Realms must delete their registry (dropping the PersistentRooted entries)
+// when they die.
+static void DestroyRealmRegistry(JSFreeOp* fop, JS::Realm* realm) {
+  delete static_cast<ModuleRegistry*>(JS::GetRealmPrivate(realm));
+  JS::SetRealmPrivate(realm, nullptr);
+}
+
+// Off-thread compilation pool. Instead of compiling each module serially when
+// its import is first resolved, we farm every known module source out to the
+// engine's helper threads up front. The resolve hook then only has to join on
+// an already-in-flight compilation, so a deep import graph parses in parallel
+// rather than one module at a time on the main thread.
+struct PendingCompile {
+  JS::OffThreadToken* token = nullptr;
+  bool done = false;
+};
+
+static std::mutex compileLock;
+static std::condition_variable compileCond;
+static std::map<std::u16string, PendingCompile> pendingCompiles;
+
+// Called on a helper thread when one off-thread compilation finishes. Only
+// record the token here; the compiled module must be claimed on the main
+// thread with JS::FinishOffThreadModule.
+static void OffThreadCompileDone(JS::OffThreadToken* token, void* data) {
+  auto* pending = static_cast<PendingCompile*>(data);
+  std::lock_guard<std::mutex> guard(compileLock);
+  pending->token = token;
+  pending->done = true;
+  compileCond.notify_all();
+}
+
+// Kick off an off-thread compilation for every known module that isn't
+// already covered by the bytecode cache. Decoding a cached entry is cheaper
+// than even a parallel parse, so those modules stay on the sync path.
+static bool StartOffThreadModuleCompiles(JSContext* cx) {
+  for (const auto& entry : moduleSources) {
+    const ExampleModuleSource& src = entry.second;
+    size_t length = strlen(src.code);
+
+    uint64_t key = HashSource(src.code, length);
+
+    JS::TranscodeRange unused;
+    struct stat sb;
+    if (sharedStencils.Lookup(key, &unused) ||
+        stat(ModuleCachePath(key).c_str(), &sb) == 0) {
+      continue;
+    }
+
+    JS::CompileOptions options(cx);
+    options.setFileAndLine(src.filename, 1);
+
+    // The engine refuses tiny sources where thread handoff would cost more
+    // than the parse itself; those compile synchronously in the resolve hook.
+    if (!JS::CanCompileOffThread(cx, options, length)) continue;
+
+    // The source buffer is borrowed for the duration of the off-thread parse;
+    // string literals in moduleSources trivially outlive it.
+    JS::SourceText<mozilla::Utf8Unit> source;
+    if (!source.init(cx, src.code, length, JS::SourceOwnership::Borrowed)) {
+      return false;
+    }
+
+    PendingCompile& pending = pendingCompiles[entry.first];
+    if (!JS::CompileOffThreadModule(cx, options, source, OffThreadCompileDone,
+                                    &pending)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// If an off-thread compilation was started for this specifier, block until it
+// finishes and claim the result. Returns nullptr when no compilation is in
+// flight (or on error with an exception pending).
+static JSObject* TakeOffThreadModule(JSContext* cx,
+                                     const std::u16string& specifier) {
+  JS::OffThreadToken* token;
+  {
+    std::unique_lock<std::mutex> guard(compileLock);
+    auto search = pendingCompiles.find(specifier);
+    if (search == pendingCompiles.end()) return nullptr;
+
+    compileCond.wait(guard, [&] { return search->second.done; });
+    token = search->second.token;
+    pendingCompiles.erase(search);
+  }
+
+  return JS::FinishOffThreadModule(cx, token);
+}
 
 // Callback for embedding to provide modules for import statements. This example
 // hardcodes sources, but an embedding would normally load files here.
@@ -55,24 +564,40 @@ static JSObject* ExampleResolveHook(JSContext* cx,
   }
   std::u16string filename(specChars.get());
 
-  // If we already resolved before, return same module.
-  auto search = moduleRegistry.find(filename);
-  if (search != moduleRegistry.end()) {
+  // If we already resolved before in this realm, return same module.
+  ModuleRegistry* registry = RegistryForCurrentRealm(cx);
+  auto search = registry->modules.find(filename);
+  if (search != registry->modules.end()) {
     return search->second;
   }
 
-  JS::RootedObject mod(cx);
+  JS::RootedObject mod(cx, TakeOffThreadModule(cx, filename));
+  if (!mod && JS_IsExceptionPending(cx)) {
+    return nullptr;
+  }
 
-  if (filename == u"a") {
-    mod = CompileExampleModule(cx, "a", "export const C1 = 1;");
-    if (!mod) {
+  // Prefer a file-backed module if one exists on disk.
+  if (!mod) {
+    mod = CompileModuleFromFile(cx, filename);
+    if (!mod && JS_IsExceptionPending(cx)) {
       return nullptr;
     }
   }
 
+  if (!mod) {
+    auto sourceEntry = moduleSources.find(filename);
+    if (sourceEntry != moduleSources.end()) {
+      mod = CompileExampleModule(cx, sourceEntry->second.filename,
+                                 sourceEntry->second.code);
+      if (!mod) {
+        return nullptr;
+      }
+    }
+  }
+
   // Register result in table.
   if (mod) {
-    moduleRegistry.emplace(filename, JS::PersistentRootedObject(cx, mod));
+    registry->modules.emplace(filename, JS::PersistentRootedObject(cx, mod));
     return mod;
   }
 
@@ -90,10 +615,36 @@ static bool ModuleExample(JSContext* cx) {
 
   // Register a hook in order to provide modules
   JS::SetModuleResolveHook(JS_GetRuntime(cx), ExampleResolveHook);
+  JS::SetDestroyRealmCallback(cx, DestroyRealmRegistry);
+
+  // Start compiling the whole import graph on helper threads before touching
+  // the top module, so resolution below overlaps with parsing. This runs
+  // before the stencil store is opened: on a cold cache the big module
+  // parses on a helper thread while the store population below parses on
+  // this one, and the resolve hook joins the in-flight compile. On warm
+  // runs the cache tiers win and the off-thread pool correctly sits out.
+  if (!StartOffThreadModuleCompiles(cx)) {
+    boilerplate::ReportAndClearException(cx);
+    return false;
+  }
+
+  // Map the shared stencil store; the first worker on the machine populates
+  // it, everyone else instantiates modules from the shared pages.
+  if (!sharedStencils.Open()) {
+    if (!StencilStore::Populate(cx)) {
+      boilerplate::ReportAndClearException(cx);
+      return false;
+    }
+    sharedStencils.Open();
+  }
 
   // Compile the top module.
   JS::RootedObject mod(
-      cx, CompileExampleModule(cx, "top", "import {C1} from 'a';"));
+      cx,
+      CompileExampleModule(cx, "top",
+                           "import {C1} from 'a';\n"
+                           "import {C2} from 'b';\n"
+                           "if (C2 !== 19900) throw new Error('bad C2');"));
   if (!mod) {
     boilerplate::ReportAndClearException(cx);
     return false;
@@ -0,0 +1,159 @@
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <jsapi.h>
+
+#include <js/Array.h>
+#include <js/ArrayBuffer.h>
+#include <js/ValueArray.h>
+
+#include "boilerplate.h"
+
+// This example exercises the multi-threaded harness from the boilerplate.
+// SpiderMonkey allows one active JSContext per thread and contexts share
+// nothing, so RunParallelJobs gives each worker thread its own context and
+// global and lets the workers drain a shared queue of script sources with no
+// locking beyond the queue index itself.
+//
+// Run with the 'channel' argument for the second demo: RunParallel workers
+// passing values to each other through a TransferChannel, with ArrayBuffer
+// payloads transferred (moved, not copied) across contexts.
+//
+// NOTE: JS_Init cannot be called again after JS_ShutDown, and the harness
+// brackets the whole run with that pair -- so a process gets exactly one
+// harness invocation; the two demos are therefore separate runs.
+
+static constexpr unsigned kThreads = 4;
+
+// Build more jobs than threads so every worker pulls several from the queue
+// rather than the threads pairing off one-to-one with the work.
+static std::vector<std::string> BuildJobs(void) {
+  std::vector<std::string> jobs;
+  for (int i = 0; i < 32; i++) {
+    char code[160];
+    snprintf(code, sizeof(code),
+             "let sum = 0;"
+             "for (let j = 0; j < 1000; j++) sum += j * %d;"
+             "if (sum !== %d * 499500) throw new Error('bad sum');",
+             i, i);
+    jobs.push_back(code);
+  }
+  return jobs;
+}
+
+///// TransferChannel demo /////////////////////////////////////////////////
+
+// One RunParallel worker consumes, the rest produce: each producer sends
+// messages whose ArrayBuffer payload is listed as transferable, so the bytes
+// move between the contexts without a copy and the sender's buffer is left
+// detached. Roles are handed out with an atomic counter -- the workers are
+// otherwise identical.
+
+static boilerplate::TransferChannel channel;
+static std::atomic<unsigned> workerRank{0};
+static std::atomic<unsigned> producersDone{0};
+
+static constexpr unsigned kMessagesPerProducer = 8;
+static constexpr size_t kPayloadBytes = 4096;
+
+static bool ProduceMessages(JSContext* cx) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+  JSAutoRealm ar(cx, global);
+
+  for (unsigned i = 0; i < kMessagesPerProducer; i++) {
+    JS::RootedObject buffer(cx, JS::NewArrayBuffer(cx, kPayloadBytes));
+    if (!buffer) return false;
+
+    JS::RootedObject message(cx, JS_NewPlainObject(cx));
+    if (!message) return false;
+    JS::RootedValue v(cx, JS::Int32Value(int32_t(i)));
+    if (!JS_SetProperty(cx, message, "seq", v)) return false;
+    v.setObject(*buffer);
+    if (!JS_SetProperty(cx, message, "payload", v)) return false;
+
+    // List the payload as transferable; everything else is deep-copied.
+    JS::RootedValueArray<1> transferList(cx);
+    transferList[0].setObject(*buffer);
+    JS::RootedObject transferArray(cx, JS::NewArrayObject(cx, transferList));
+    if (!transferArray) return false;
+
+    JS::RootedValue messageVal(cx, JS::ObjectValue(*message));
+    JS::RootedValue transferVal(cx, JS::ObjectValue(*transferArray));
+    if (!channel.Send(cx, messageVal, transferVal)) return false;
+
+    // The transfer detached the sender's copy; its contents are gone.
+    assert(JS::IsDetachedArrayBufferObject(buffer));
+  }
+  return true;
+}
+
+static bool ConsumeMessages(JSContext* cx) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+  JSAutoRealm ar(cx, global);
+
+  unsigned received = 0;
+  for (;;) {
+    JS::RootedValue value(cx);
+    bool closed = false;
+    if (!channel.Receive(cx, &value, &closed)) {
+      if (closed) break;
+      boilerplate::ReportAndClearException(cx);
+      return false;
+    }
+
+    // Deserialized into this realm: a plain object carrying the transferred
+    // bytes, never a wrapper into the producer's heap.
+    JS::RootedObject message(cx, &value.toObject());
+    JS::RootedValue payload(cx);
+    if (!JS_GetProperty(cx, message, "payload", &payload)) return false;
+    if (!payload.isObject() ||
+        JS::GetArrayBufferByteLength(&payload.toObject()) != kPayloadBytes) {
+      fprintf(stderr, "message arrived without its payload\n");
+      return false;
+    }
+    received++;
+  }
+
+  if (received != (kThreads - 1) * kMessagesPerProducer) {
+    fprintf(stderr, "expected %u messages, received %u\n",
+            (kThreads - 1) * kMessagesPerProducer, received);
+    return false;
+  }
+  printf("received %u messages of %zu transferred bytes each\n", received,
+         kPayloadBytes);
+  return true;
+}
+
+static bool ChannelTask(JSContext* cx) {
+  if (workerRank.fetch_add(1) == 0) return ConsumeMessages(cx);
+
+  bool ok = ProduceMessages(cx);
+  // Last producer out closes the channel, releasing the consumer.
+  if (producersDone.fetch_add(1) + 1 == kThreads - 1) channel.Close();
+  return ok;
+}
+
+int main(int argc, const char* argv[]) {
+  if (argc > 1 && strcmp(argv[1], "channel") == 0) {
+    if (!boilerplate::RunParallel(ChannelTask, kThreads)) {
+      fprintf(stderr, "transfer channel demo failed\n");
+      return 1;
+    }
+    return 0;
+  }
+
+  std::vector<std::string> jobs = BuildJobs();
+  if (!boilerplate::RunParallelJobs(jobs, kThreads)) {
+    fprintf(stderr, "parallel job queue failed\n");
+    return 1;
+  }
+
+  printf("ran %zu jobs across %u threads\n", jobs.size(), kThreads);
+  return 0;
+}
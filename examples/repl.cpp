@@ -1,9 +1,20 @@
 #include <cassert>
+#include <chrono>
 #include <codecvt>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <iostream>
 #include <locale>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <vector>
+
+#include <poll.h>
+#include <unistd.h>
 
 #include <jsapi.h>
 #include <jsfriendapi.h>
@@ -15,7 +26,9 @@
 #include <js/ErrorReport.h>
 #include <js/Exception.h>
 #include <js/Initialization.h>
+#include <js/Promise.h>
 #include <js/SourceText.h>
+#include <js/Transcoding.h>
 #include <js/Warnings.h>
 
 #include <readline/history.h>
@@ -30,11 +43,175 @@
  * stdout and stderr. On Linux and macOS this will usually be the case. On
  * Windows you may have to set your terminal's codepage to UTF-8. */
 
+/* The REPL runs as an event loop: readline is driven in callback mode from
+ * the same thread, with poll() multiplexing stdin, timers and promise
+ * microtasks. Promise jobs therefore keep resolving while the user is
+ * typing, instead of only after each submitted line as with the engine's
+ * internal job queue. */
+
+/* An embedder-owned microtask queue, installed with JS::SetJobQueue. The
+ * engine calls enqueuePromiseJob when a promise reaction is scheduled; the
+ * event loop decides when to drain. */
+class ReplJobQueue final : public JS::JobQueue {
+  /* Jobs only ever touched on the JS thread, so no locking here. */
+  std::deque<JS::PersistentRootedObject> m_jobs;
+  bool m_draining = false;
+
+ public:
+  JSObject* getIncumbentGlobal(JSContext* cx) override {
+    return JS::CurrentGlobalOrNull(cx);
+  }
+
+  bool enqueuePromiseJob(JSContext* cx, JS::HandleObject promise,
+                         JS::HandleObject job, JS::HandleObject allocationSite,
+                         JS::HandleObject incumbentGlobal) override {
+    m_jobs.emplace_back(cx, job);
+    return true;
+  }
+
+  void runJobs(JSContext* cx) override {
+    /* Jobs can enqueue more jobs; drain until a fixed point, but don't
+     * re-enter if a job's side effects end up back here. */
+    if (m_draining) return;
+    m_draining = true;
+
+    while (!m_jobs.empty()) {
+      JS::RootedValue job(cx, JS::ObjectValue(*m_jobs.front()));
+      m_jobs.pop_front();
+
+      JS::RootedValue rval(cx);
+      if (!JS_CallFunctionValue(cx, nullptr, job,
+                                JS::HandleValueArray::empty(), &rval)) {
+        boilerplate::ReportAndClearException(cx);
+      }
+    }
+
+    m_draining = false;
+  }
+
+  bool empty(void) const override { return m_jobs.empty(); }
+
+ private:
+  js::UniquePtr<SavedJobQueue> saveJobQueue(JSContext* cx) override {
+    /* Queue save/restore is only needed by the debugger; not supported. */
+    JS_ReportErrorASCII(cx, "job queue saving is not supported");
+    return nullptr;
+  }
+};
+static ReplJobQueue jobQueue;
+
+/* The loop's unit queue, timer list and wakeup channel. Everything runs on
+ * the JS thread today, but the locking and the self-pipe keep the structure
+ * sound if an embedding adds producer threads (and let quit() interrupt a
+ * poll() that is already parked). */
+class EventLoop {
+ public:
+  std::mutex lock;
+  std::deque<std::string> pendingUnits;
+  bool inputClosed = false;
+
+  struct Timer {
+    std::chrono::steady_clock::time_point deadline;
+    JS::PersistentRootedObject callback;
+  };
+  /* Few timers in a REPL; a sorted-on-demand vector beats a heap here. */
+  std::vector<std::unique_ptr<Timer>> timers;
+
+  int wakeRead = -1;
+  int wakeWrite = -1;
+
+  bool init(void) {
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+    wakeRead = fds[0];
+    wakeWrite = fds[1];
+    return true;
+  }
+
+  void wake(void) {
+    char byte = 0;
+    mozilla::Unused << write(wakeWrite, &byte, 1);
+  }
+
+  void pushUnit(std::string unit) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      pendingUnits.push_back(std::move(unit));
+    }
+    wake();
+  }
+
+  void closeInput(void) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      inputClosed = true;
+    }
+    wake();
+  }
+
+  void addTimer(JSContext* cx, JS::HandleObject callback, double delayMs) {
+    auto timer = std::make_unique<Timer>();
+    timer->deadline = std::chrono::steady_clock::now() +
+                      std::chrono::milliseconds(int64_t(delayMs));
+    timer->callback.init(cx, callback);
+
+    std::lock_guard<std::mutex> guard(lock);
+    timers.push_back(std::move(timer));
+  }
+
+  /* Milliseconds until the earliest timer, or -1 (poll forever) if none. */
+  int nextTimeoutMs(void) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (timers.empty()) return -1;
+
+    auto earliest = timers[0]->deadline;
+    for (const auto& timer : timers) {
+      if (timer->deadline < earliest) earliest = timer->deadline;
+    }
+
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        earliest - std::chrono::steady_clock::now());
+    return remaining.count() < 0 ? 0 : int(remaining.count());
+  }
+
+  void takeDueTimers(std::vector<std::unique_ptr<Timer>>* due) {
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> guard(lock);
+    for (size_t i = 0; i < timers.size();) {
+      if (timers[i]->deadline <= now) {
+        due->push_back(std::move(timers[i]));
+        timers.erase(timers.begin() + i);
+      } else {
+        i++;
+      }
+    }
+  }
+};
+static EventLoop eventLoop;
+
 class ReplGlobal {
   bool m_shouldQuit : 1;
 
   ReplGlobal(void) : m_shouldQuit(false) {}
 
+  friend class boilerplate::ArenaPool<ReplGlobal>;
+
+  // Private structs are allocated from a slab arena rather than with bare
+  // new; the finalize hook returns the block to the arena. One REPL only ever
+  // has one global, but this is the pattern to follow for classes that create
+  // many instances.
+  static boilerplate::ArenaPool<ReplGlobal>& pool(void) {
+    static boilerplate::ArenaPool<ReplGlobal> instance;
+    return instance;
+  }
+
+  static void finalize(JSFreeOp* fop, JSObject* obj) {
+    if (auto* retval = static_cast<ReplGlobal*>(JS::GetPrivate(obj))) {
+      pool().Delete(retval);
+      JS::SetPrivate(obj, nullptr);
+    }
+  }
+
   static ReplGlobal* priv(JSObject* global) {
     //auto* retval = JS_GetInstancePrivate(context, obj, class, args);
     auto* retval = static_cast<ReplGlobal*>(JS::GetPrivate(global));
@@ -47,50 +224,320 @@ class ReplGlobal {
     JS::RootedObject global(cx, JS::GetNonCCWObjectGlobal(&args.callee()));
     if (!global) return false;
 
-    // Return an "uncatchable" exception, by returning false without setting an
-    // exception to be pending. We distinguish it from any other uncatchable
-    // that the JS engine might throw, by setting m_shouldQuit
+    // No uncatchable-exception trick (returning false with no pending
+    // exception): that makes every caller distinguish "real failure" from
+    // "quit", and anything that reports errors on failure does needless
+    // work. quit() just sets the flag, wakes the loop, and succeeds; the
+    // scheduler checks m_shouldQuit at the top of each turn.
     priv(global)->m_shouldQuit = true;
-    js::StopDrainingJobQueue(cx);
-    return false;
+    eventLoop.wake();
+    args.rval().setUndefined();
+    return true;
+  }
+
+  // A minimal setTimeout(callback, delayMs): schedules the callback on the
+  // event loop's timer list. Demonstrates that timers, input and microtasks
+  // all interleave in the same loop.
+  static bool setTimeout(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    if (!args.requireAtLeast(cx, "setTimeout", 1)) return false;
+
+    if (!args[0].isObject() || !JS::IsCallable(&args[0].toObject())) {
+      JS_ReportErrorASCII(cx, "setTimeout expects a function");
+      return false;
+    }
+    JS::RootedObject callback(cx, &args[0].toObject());
+
+    double delayMs = 0;
+    if (args.length() > 1 && !JS::ToNumber(cx, args[1], &delayMs)) return false;
+
+    eventLoop.addTimer(cx, callback, delayMs < 0 ? 0 : delayMs);
+    args.rval().setUndefined();
+    return true;
   }
 
+  /* Same hooks as JS::DefaultGlobalClassOps, plus a finalizer to release the
+   * private struct back to the arena. */
+  static constexpr JSClassOps classOps = {
+      nullptr,  // addProperty
+      nullptr,  // deleteProperty
+      nullptr,  // enumerate
+      JS_NewEnumerateStandardClasses,
+      JS_ResolveStandardClass,
+      JS_MayResolveStandardClass,
+      &ReplGlobal::finalize,
+      nullptr,  // call
+      nullptr,  // hasInstance
+      nullptr,  // construct
+      JS_GlobalObjectTraceHook,
+  };
+
   /* The class of the global object. */
   static constexpr JSClass klass = {"ReplGlobal",
                                     JSCLASS_GLOBAL_FLAGS | JSCLASS_HAS_PRIVATE,
-                                    &JS::DefaultGlobalClassOps};
+                                    &ReplGlobal::classOps};
 
   static constexpr JSFunctionSpec functions[] = {
-      JS_FN("quit", &ReplGlobal::quit, 0, 0), JS_FS_END};
+      JS_FN("quit", &ReplGlobal::quit, 0, 0),
+      JS_FN("setTimeout", &ReplGlobal::setTimeout, 1, 0), JS_FS_END};
 
  public:
   static JSObject* create(JSContext* cx);
   static void loop(JSContext* cx, JS::HandleObject global);
+
+  static bool quitRequested(JSContext* cx) {
+    JSObject* global = JS::CurrentGlobalOrNull(cx);
+    return global && priv(global)->m_shouldQuit;
+  }
 };
+constexpr JSClassOps ReplGlobal::classOps;
 constexpr JSClass ReplGlobal::klass;
 constexpr JSFunctionSpec ReplGlobal::functions[];
 
-std::string FormatString(JSContext* cx, JS::HandleString string) {
-  std::string buf = "\"";
+/* Fast per-line scanner used to decide when the accumulated REPL input might
+ * form a compilable unit. JS_Utf8BufferIsCompilableUnit reparses the whole
+ * buffer, which is O(n^2) over a large multi-line paste if we call it after
+ * every line; instead we track bracket/template-literal depth a line at a
+ * time and only run the real (authoritative) check when the depth reaches
+ * zero. The scanner is deliberately approximate -- regex literals, say, are
+ * treated as code -- but a false "might be complete" only costs one full
+ * check, which is exactly what the old code did on every line. A false
+ * "incomplete" (a bracket inside a regex character class, say) would be
+ * worse -- the unit could never submit -- so the input handler also runs
+ * the authoritative check on every empty line, making a bare Enter the
+ * bounded escape hatch out of any scanner misjudgment. */
+class CompilableUnitScanner {
+  enum class State { Code, SingleQuote, DoubleQuote, Template, BlockComment };
+
+  /* Open contexts: '(', '[', '{' for brackets, '`' for template literals,
+   * '$' for a ${...} substitution inside a template. */
+  std::vector<char> m_stack;
+  State m_state = State::Code;
+
+  void pop(char expected) {
+    if (!m_stack.empty() && m_stack.back() == expected) m_stack.pop_back();
+  }
 
-  JS::UniqueChars chars(JS_EncodeStringToUTF8(cx, string));
-  if (!chars) {
-    JS_ClearPendingException(cx);
-    return "[invalid string]";
+ public:
+  /* Consume one line of input (without its newline). O(length). */
+  void feed(const char* chars, size_t length) {
+    bool escaped = false;
+    for (size_t i = 0; i < length; i++) {
+      char c = chars[i];
+
+      if (escaped) {
+        escaped = false;
+        continue;
+      }
+      if (c == '\\' && m_state != State::BlockComment) {
+        escaped = true;
+        continue;
+      }
+
+      switch (m_state) {
+        case State::Code:
+          switch (c) {
+            case '(':
+            case '[':
+            case '{':
+              m_stack.push_back(c);
+              break;
+            case ')':
+              pop('(');
+              break;
+            case ']':
+              pop('[');
+              break;
+            case '}':
+              if (!m_stack.empty() && m_stack.back() == '$') {
+                /* End of a ${...} substitution: back into the template. */
+                m_stack.pop_back();
+                m_state = State::Template;
+              } else {
+                pop('{');
+              }
+              break;
+            case '\'':
+              m_state = State::SingleQuote;
+              break;
+            case '"':
+              m_state = State::DoubleQuote;
+              break;
+            case '`':
+              m_stack.push_back('`');
+              m_state = State::Template;
+              break;
+            case '/':
+              if (i + 1 < length && chars[i + 1] == '/') return;  // comment
+              if (i + 1 < length && chars[i + 1] == '*') {
+                m_state = State::BlockComment;
+                i++;
+              }
+              break;
+          }
+          break;
+
+        case State::SingleQuote:
+          if (c == '\'') m_state = State::Code;
+          break;
+
+        case State::DoubleQuote:
+          if (c == '"') m_state = State::Code;
+          break;
+
+        case State::Template:
+          if (c == '`') {
+            pop('`');
+            m_state = State::Code;
+          } else if (c == '$' && i + 1 < length && chars[i + 1] == '{') {
+            m_stack.push_back('$');
+            m_state = State::Code;
+            i++;
+          }
+          break;
+
+        case State::BlockComment:
+          if (c == '*' && i + 1 < length && chars[i + 1] == '/') {
+            m_state = State::Code;
+            i++;
+          }
+          break;
+      }
+    }
+
+    /* A newline terminates ordinary strings (as a syntax error, which the
+     * real compile will report); only templates and block comments continue
+     * across lines. */
+    if (m_state == State::SingleQuote || m_state == State::DoubleQuote)
+      m_state = State::Code;
+  }
+
+  /* True when no bracket, template literal or block comment is open, i.e.
+   * when it's worth paying for the authoritative check. */
+  bool mightBeComplete(void) const {
+    return m_stack.empty() && m_state == State::Code;
+  }
+};
+
+/* A reusable, growable output buffer for formatting results. The backing
+ * storage is retained across uses, so after warm-up the common case writes
+ * into already-allocated memory: formatting a latin1 string costs zero heap
+ * allocations, where JS_EncodeStringToUTF8 mallocs a UTF-8 copy that we then
+ * copied *again* into a std::string. */
+class FormatBuffer {
+  std::vector<char> m_storage;
+  size_t m_length = 0;
+
+ public:
+  void clear(void) { m_length = 0; }
+  const char* data(void) const { return m_storage.data(); }
+  size_t length(void) const { return m_length; }
+
+  /* Make room for at least n more bytes and return the write cursor; call
+   * commit() with the number actually written. */
+  char* reserve(size_t n) {
+    if (m_length + n > m_storage.size()) m_storage.resize(m_length + n);
+    return m_storage.data() + m_length;
+  }
+  void commit(size_t n) { m_length += n; }
+
+  void append(const char* chars, size_t n) {
+    memcpy(reserve(n), chars, n);
+    commit(n);
+  }
+  void append(const char* chars) { append(chars, strlen(chars)); }
+  void append(char c) {
+    *reserve(1) = c;
+    commit(1);
+  }
+};
+
+/* Append a JS string's characters, transcoded to UTF-8, directly from the
+ * engine's own character storage. Linearizing first flattens ropes once;
+ * after that the latin1 or two-byte chars are read in place under
+ * AutoCheckCannotGC, with no intermediate copy. */
+static bool AppendString(JSContext* cx, FormatBuffer& out,
+                         JS::HandleString string) {
+  JSLinearString* linear = JS_EnsureLinearString(cx, string);
+  if (!linear) return false;
+
+  size_t length = JS_GetLinearStringLength(linear);
+
+  JS::AutoCheckCannotGC nogc;
+  if (JS_LinearStringHasLatin1Chars(linear)) {
+    const JS::Latin1Char* chars = JS_GetLatin1LinearStringChars(nogc, linear);
+
+    /* Latin1 code points 0x80-0xff become two UTF-8 bytes; reserving 2x up
+     * front keeps this a single pass. */
+    char* cursor = out.reserve(length * 2);
+    char* write = cursor;
+    for (size_t i = 0; i < length; i++) {
+      JS::Latin1Char c = chars[i];
+      if (c < 0x80) {
+        *write++ = char(c);
+      } else {
+        *write++ = char(0xc0 | (c >> 6));
+        *write++ = char(0x80 | (c & 0x3f));
+      }
+    }
+    out.commit(size_t(write - cursor));
+    return true;
+  }
+
+  const char16_t* chars = JS_GetTwoByteLinearStringChars(nogc, linear);
+
+  /* Worst case a UTF-16 code unit expands to three UTF-8 bytes (a surrogate
+   * pair: 4 bytes from 2 units). */
+  char* cursor = out.reserve(length * 3);
+  char* write = cursor;
+  for (size_t i = 0; i < length; i++) {
+    char16_t c = chars[i];
+    if (c < 0x80) {
+      *write++ = char(c);
+    } else if (c < 0x800) {
+      *write++ = char(0xc0 | (c >> 6));
+      *write++ = char(0x80 | (c & 0x3f));
+    } else if (c >= 0xd800 && c < 0xdc00 && i + 1 < length &&
+               chars[i + 1] >= 0xdc00 && chars[i + 1] < 0xe000) {
+      uint32_t cp = 0x10000 + ((uint32_t(c - 0xd800) << 10) |
+                               uint32_t(chars[i + 1] - 0xdc00));
+      *write++ = char(0xf0 | (cp >> 18));
+      *write++ = char(0x80 | ((cp >> 12) & 0x3f));
+      *write++ = char(0x80 | ((cp >> 6) & 0x3f));
+      *write++ = char(0x80 | (cp & 0x3f));
+      i++;
+    } else {
+      /* Lone surrogates encode as replacement-free three bytes, matching
+       * what JS_EncodeStringToUTF8 produced. */
+      *write++ = char(0xe0 | (c >> 12));
+      *write++ = char(0x80 | ((c >> 6) & 0x3f));
+      *write++ = char(0x80 | (c & 0x3f));
+    }
   }
+  out.commit(size_t(write - cursor));
+  return true;
+}
 
-  buf += chars.get();
-  buf += '"';
-  return buf;
+static void FormatString(JSContext* cx, FormatBuffer& out,
+                         JS::HandleString string) {
+  out.append('"');
+  if (!AppendString(cx, out, string)) {
+    JS_ClearPendingException(cx);
+    out.append("[invalid string]");
+    return;
+  }
+  out.append('"');
 }
 
-std::string FormatResult(JSContext* cx, JS::HandleValue value) {
+static void FormatResult(JSContext* cx, FormatBuffer& out,
+                         JS::HandleValue value) {
   JS::RootedString str(cx);
 
   /* Special case format for strings */
   if (value.isString()) {
     str = value.toString();
-    return FormatString(cx, str);
+    FormatString(cx, out, str);
+    return;
   }
 
   str = JS::ToString(cx, value);
@@ -106,25 +553,26 @@ std::string FormatResult(JSContext* cx, JS::HandleValue value) {
       const JSClass* klass = JS::GetClass(&value.toObject());
       if (klass)
         str = JS_NewStringCopyZ(cx, klass->name);
-      else
-        return "[unknown object]";
+      else {
+        out.append("[unknown object]");
+        return;
+      }
     } else {
-      return "[unknown non-object]";
+      out.append("[unknown non-object]");
+      return;
     }
   }
 
   if (!str) {
     JS_ClearPendingException(cx);
-    return "[invalid class]";
+    out.append("[invalid class]");
+    return;
   }
 
-  JS::UniqueChars bytes(JS_EncodeStringToUTF8(cx, str));
-  if (!bytes) {
+  if (!AppendString(cx, out, str)) {
     JS_ClearPendingException(cx);
-    return "[invalid string]";
+    out.append("[invalid string]");
   }
-
-  return bytes.get();
 }
 
 JSObject* ReplGlobal::create(JSContext* cx) {
@@ -133,7 +581,11 @@ JSObject* ReplGlobal::create(JSContext* cx) {
                           JS_NewGlobalObject(cx, &ReplGlobal::klass, nullptr,
                                              JS::FireOnNewGlobalHook, options));
 
-  ReplGlobal* priv = new ReplGlobal();
+  ReplGlobal* priv = ReplGlobal::pool().New();
+  if (!priv) {
+    JS_ReportOutOfMemory(cx);
+    return nullptr;
+  }
   JS::SetPrivate(global, priv);
 
   // Define any extra global functions that we want in our environment.
@@ -143,6 +595,93 @@ JSObject* ReplGlobal::create(JSContext* cx) {
   return global;
 }
 
+/* Session persistence. Each successfully-evaluated input unit's compiled
+ * script is appended to a log as XDR bytecode (length-prefixed records), and
+ * the next session replays the log before reading input -- the operator's
+ * whole prelude re-executes straight from bytecode, with no reparse. The
+ * readline history is saved next to it so the arrow keys come back too.
+ * A record that fails to decode (corrupt file, engine version skew) discards
+ * the rest of the cache; the session still starts, just cold. */
+class SessionLog {
+  FILE* m_log = nullptr;
+
+  static const char* Path(void) {
+    const char* path = getenv("REPL_SESSION");
+    return path ? path : ".repl-session.xdr";
+  }
+
+ public:
+  static const char* HistoryPath(void) {
+    const char* path = getenv("REPL_HISTORY");
+    return path ? path : ".repl-history";
+  }
+
+  // Execute every script recorded by previous sessions.
+  void Replay(JSContext* cx) {
+    FILE* file = fopen(Path(), "rb");
+    if (!file) return;  // no previous session
+
+    bool intact = true;
+    for (;;) {
+      uint32_t length;
+      if (fread(&length, sizeof(length), 1, file) != 1) break;  // end of log
+
+      JS::TranscodeBuffer buffer;
+      if (length == 0 || !buffer.growBy(length) ||
+          fread(buffer.begin(), 1, length, file) != length) {
+        intact = false;
+        break;
+      }
+
+      JS::CompileOptions options(cx);
+      options.setFileAndLine("<session>", 1);
+      JS::RootedScript script(cx);
+      if (JS::DecodeScript(cx, options, buffer, &script) !=
+          JS::TranscodeResult::Ok) {
+        JS_ClearPendingException(cx);
+        intact = false;
+        break;
+      }
+
+      // The unit succeeded when it was recorded; if the world has changed
+      // and it fails now, report and keep replaying the rest.
+      JS::RootedValue ignored(cx);
+      if (!JS_ExecuteScript(cx, script, &ignored)) {
+        boilerplate::ReportAndClearException(cx);
+      }
+    }
+    fclose(file);
+
+    if (!intact) remove(Path());  // start a fresh cache
+  }
+
+  void OpenForAppend(void) { m_log = fopen(Path(), "ab"); }
+
+  void Record(JSContext* cx, JS::HandleScript script) {
+    if (!m_log) return;
+
+    JS::TranscodeBuffer buffer;
+    if (JS::EncodeScript(cx, buffer, script) != JS::TranscodeResult::Ok) {
+      JS_ClearPendingException(cx);  // unencodable unit: just don't persist it
+      return;
+    }
+
+    uint32_t length = uint32_t(buffer.length());
+    if (fwrite(&length, sizeof(length), 1, m_log) == 1) {
+      mozilla::Unused << fwrite(buffer.begin(), 1, length, m_log);
+    }
+    fflush(m_log);
+  }
+
+  void Close(void) {
+    if (m_log) {
+      fclose(m_log);
+      m_log = nullptr;
+    }
+  }
+};
+static SessionLog sessionLog;
+
 bool EvalAndPrint(JSContext* cx, const std::string& buffer, unsigned lineno) {
   JS::CompileOptions options(cx);
   options.setFileAndLine("typein", lineno);
@@ -153,63 +692,178 @@ bool EvalAndPrint(JSContext* cx, const std::string& buffer, unsigned lineno) {
     return false;
   }
 
+  JS::RootedScript script(cx, JS::Compile(cx, options, source));
+  if (!script) return false;
+
   JS::RootedValue result(cx);
-  if (!JS::Evaluate(cx, options, source, &result)) return false;
+  if (!JS_ExecuteScript(cx, script, &result)) return false;
+
+  // The unit succeeded: persist its bytecode for the next session. A unit
+  // that requested quit ends the session rather than belonging to it.
+  if (!ReplGlobal::quitRequested(cx)) sessionLog.Record(cx, script);
 
   JS_MaybeGC(cx);
 
   if (result.isUndefined()) return true;
 
-  std::string display_str = FormatResult(cx, result);
-  if (!display_str.empty()) std::cout << display_str << '\n';
+  /* One buffer for the life of the REPL; its storage is recycled for every
+   * result formatted. */
+  static FormatBuffer displayBuffer;
+  displayBuffer.clear();
+  FormatResult(cx, displayBuffer, result);
+  if (displayBuffer.length() > 0) {
+    std::cout.write(displayBuffer.data(), displayBuffer.length());
+    std::cout << '\n';
+  }
   return true;
 }
 
+// The input side of the REPL, driven from the JS thread with readline's
+// callback interface: the event loop polls stdin and feeds bytes to readline
+// as they arrive, so nothing ever blocks inside readline() and there is no
+// input thread to unblock at shutdown. Lines accumulate until the scanner
+// says all brackets are balanced; only then does the authoritative
+// JS_Utf8BufferIsCompilableUnit run -- and input that is bracket-balanced
+// but still unfinished ('let x =', 'if (cond)') stays open at the
+// continuation prompt rather than being submitted as a syntax error.
+static JSContext* inputCx = nullptr;
+static std::string inputBuffer;
+static CompilableUnitScanner inputScanner;
+
+static void HandleLine(char* line) {
+  if (!line) {
+    // EOF (ctrl-D). Whatever is in the buffer is all the input there will
+    // ever be; submit it and let the compile report any incompleteness.
+    rl_callback_handler_remove();
+    if (!inputBuffer.empty()) eventLoop.pushUnit(std::move(inputBuffer));
+    eventLoop.closeInput();
+    return;
+  }
+
+  bool blank = (line[0] == '\0');
+  if (!blank) add_history(line);
+  inputScanner.feed(line, strlen(line));
+  inputBuffer += line;
+  inputBuffer += '\n';
+  free(line);
+
+  // Cheap gate first, authoritative check second (see
+  // CompilableUnitScanner above). A blank line bypasses the gate: the
+  // scanner can misread valid input as unbalanced forever (e.g. the '[' in
+  // /[(]/), and pressing Enter must always be able to submit a unit the
+  // real parser considers complete.
+  bool complete = false;
+  if (inputScanner.mightBeComplete() || blank) {
+    JS::RootedObject global(inputCx, JS::CurrentGlobalOrNull(inputCx));
+    complete = JS_Utf8BufferIsCompilableUnit(
+        inputCx, global, inputBuffer.c_str(), inputBuffer.size());
+  }
+
+  if (complete) {
+    eventLoop.pushUnit(std::move(inputBuffer));
+    inputBuffer.clear();
+    inputScanner = CompilableUnitScanner();
+  }
+
+  // Re-arm with the prompt matching the buffer state. (Reinstalling from
+  // inside the handler is the documented way to change the prompt.)
+  rl_callback_handler_remove();
+  rl_callback_handler_install(complete ? "js> " : "... ", HandleLine);
+}
+
+// The JS side of the REPL: a poll()-driven scheduler interleaving input
+// units, due timers, and the promise microtask queue. Microtasks drain after
+// every callback, matching what a web event loop does between tasks.
 void ReplGlobal::loop(JSContext* cx, JS::HandleObject global) {
-  bool eof = false;
   unsigned lineno = 1;
-  do {
-    // Accumulate lines until we get a 'compilable unit' - one that either
-    // generates an error (before running out of source) or that compiles
-    // cleanly.  This should be whenever we get a complete statement that
-    // coincides with the end of a line.
-    unsigned startline = lineno;
-    std::string buffer;
-
-    do {
-      const char* prompt = startline == lineno ? "js> " : "... ";
-      char* line = readline(prompt);
-      if (!line) {
-        eof = true;
-        break;
+
+  while (!priv(global)->m_shouldQuit) {
+    bool inputDone;
+    {
+      std::lock_guard<std::mutex> guard(eventLoop.lock);
+      inputDone = eventLoop.inputClosed && eventLoop.pendingUnits.empty();
+    }
+    int timeout = eventLoop.nextTimeoutMs();
+    if (inputDone && timeout < 0 && jobQueue.empty()) break;
+
+    bool inputOpen;
+    {
+      std::lock_guard<std::mutex> guard(eventLoop.lock);
+      inputOpen = !eventLoop.inputClosed;
+    }
+
+    // Sleep until input arrives, a wakeup is posted or the next timer is due.
+    struct pollfd pfds[2] = {{eventLoop.wakeRead, POLLIN, 0},
+                             {STDIN_FILENO, POLLIN, 0}};
+    poll(pfds, inputOpen ? 2 : 1, timeout);
+    if (pfds[0].revents & POLLIN) {
+      char drain[64];
+      mozilla::Unused << read(eventLoop.wakeRead, drain, sizeof(drain));
+    }
+
+    if (inputOpen && (pfds[1].revents & (POLLIN | POLLHUP))) {
+      // Hand readline every byte already buffered, so a multi-line paste
+      // costs one trip around the loop rather than one per character.
+      struct pollfd stdinPfd = {STDIN_FILENO, POLLIN, 0};
+      do {
+        rl_callback_read_char();
+        {
+          std::lock_guard<std::mutex> guard(eventLoop.lock);
+          if (eventLoop.inputClosed) break;  // handler saw EOF
+        }
+        stdinPfd.revents = 0;
+      } while (poll(&stdinPfd, 1, 0) > 0 && (stdinPfd.revents & POLLIN));
+    }
+
+    // Evaluate any complete input units.
+    for (;;) {
+      std::string unit;
+      {
+        std::lock_guard<std::mutex> guard(eventLoop.lock);
+        if (eventLoop.pendingUnits.empty()) break;
+        unit = std::move(eventLoop.pendingUnits.front());
+        eventLoop.pendingUnits.pop_front();
+      }
+
+      unsigned startline = lineno;
+      for (char c : unit) {
+        if (c == '\n') lineno++;
       }
-      if (line[0] != '\0') add_history(line);
-      buffer += line;
-      lineno++;
-    } while (!JS_Utf8BufferIsCompilableUnit(cx, global, buffer.c_str(),
-                                            buffer.length()));
-
-    if (!EvalAndPrint(cx, buffer, startline)) {
-      if (!priv(global)->m_shouldQuit) {
+
+      if (!EvalAndPrint(cx, unit, startline)) {
+        if (priv(global)->m_shouldQuit) return;
         boilerplate::ReportAndClearException(cx);
       }
+
+      jobQueue.runJobs(cx);
+      if (priv(global)->m_shouldQuit) return;
     }
 
-    js::RunJobs(cx);
-  } while (!eof && !priv(global)->m_shouldQuit);
+    // Fire timers that have come due.
+    std::vector<std::unique_ptr<EventLoop::Timer>> due;
+    eventLoop.takeDueTimers(&due);
+    for (const auto& timer : due) {
+      JS::RootedValue callback(cx, JS::ObjectValue(*timer->callback));
+      JS::RootedValue rval(cx);
+      if (!JS_CallFunctionValue(cx, nullptr, callback,
+                                JS::HandleValueArray::empty(), &rval)) {
+        if (priv(global)->m_shouldQuit) return;
+        boilerplate::ReportAndClearException(cx);
+      }
+      jobQueue.runJobs(cx);
+    }
+  }
 }
 
 static bool RunREPL(JSContext* cx) {
-  // In order to use Promises in the REPL, we need a job queue to process
-  // events after each line of input is processed.
-  //
-  // A more sophisticated embedding would schedule it's own tasks and use
-  // JS::SetEnqueuePromiseJobCallback(), JS::SetGetIncumbentGlobalCallback(),
-  // and JS::SetPromiseRejectionTrackerCallback().
-  if (!js::UseInternalJobQueues(cx)) return false;
+  // In order to use Promises in the REPL, we need a job queue. Rather than
+  // the engine's internal queue (which only drains when the embedding says
+  // run-everything), we install our own so the event loop can interleave
+  // microtasks with timers and input.
+  JS::SetJobQueue(cx, &jobQueue);
 
   // We must instantiate self-hosting *after* setting up job queue.
-  if (!JS::InitSelfHostedCode(cx)) return false;
+  if (!boilerplate::InitSelfHostedCodeCached(cx)) return false;
 
   JS::RootedObject global(cx, ReplGlobal::create(cx));
   if (!global) return false;
@@ -220,13 +874,64 @@ static bool RunREPL(JSContext* cx) {
     JS::PrintError(stderr, report, true);
   });
 
+  // Restore the previous session: readline history for the arrow keys, then
+  // the compiled prelude from bytecode -- before the first prompt appears.
+  read_history(SessionLog::HistoryPath());
+  sessionLog.Replay(cx);
+  sessionLog.OpenForAppend();
+
+  if (!eventLoop.init()) return false;
+
+  inputCx = cx;
+  rl_callback_handler_install("js> ", HandleLine);
+
   ReplGlobal::loop(cx, global);
 
+  // If quit() ended the loop with the prompt still active, put the terminal
+  // back the way readline found it. (No-op after EOF already removed it.)
+  rl_callback_handler_remove();
+  inputCx = nullptr;
+
+  sessionLog.Close();
+  write_history(SessionLog::HistoryPath());
+
   std::cout << '\n';
   return true;
 }
 
+// Non-interactive mode: any file arguments are evaluated in order through
+// the boilerplate's EvaluateFile -- the mmap-backed path where the parser
+// reads borrowed pages straight out of the page cache -- and the process
+// exits instead of prompting. 'repl - < pipe' exercises the chunked-read
+// fallback for non-mappable input.
+static int scriptArgc = 0;
+static const char* const* scriptArgv = nullptr;
+
+static bool RunScriptFiles(JSContext* cx) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+  JSAutoRealm ar(cx, global);
+
+  for (int i = 1; i < scriptArgc; i++) {
+    const char* path = scriptArgv[i];
+    if (strcmp(path, "-") == 0) path = "/dev/stdin";
+
+    JS::RootedValue result(cx);
+    if (!boilerplate::EvaluateFile(cx, path, &result)) {
+      boilerplate::ReportAndClearException(cx);
+      return false;
+    }
+  }
+  return true;
+}
+
 int main(int argc, const char* argv[]) {
+  if (argc > 1) {
+    scriptArgc = argc;
+    scriptArgv = argv;
+    return boilerplate::RunExample(RunScriptFiles) ? 0 : 1;
+  }
+
   if (!boilerplate::RunExample(RunREPL, /* initSelfHosting = */ false))
     return 1;
   return 0;
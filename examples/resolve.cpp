@@ -1,3 +1,5 @@
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <limits>
 
@@ -17,6 +19,14 @@ namespace zlib {
 #include <zlib.h>
 }
 
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAVE_X86_CRC32C 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define HAVE_ARM_CRC32C 1
+#endif
+
 /* This example illustrates how to set up a class with a custom resolve hook, in
  * order to do lazy property resolution.
  *
@@ -25,22 +35,214 @@ namespace zlib {
  * so it's likely to be installed anywhere these examples are being compiled.
  *
  * There will be two properties that can resolve lazily: an `update()` method,
- * and a `checksum` property. */
+ * and a `checksum` property.
+ *
+ * On top of that, the class resolves a few high-throughput hashing kernels
+ * the same lazy way: `update64()` / `crc32c` feed a CRC-32C state through the
+ * CPU's crc32 instructions (SSE4.2 or ARMv8 CRC, ~15GB/s vs ~1GB/s for the
+ * scalar table loop), and `xxhash()` runs XXH64 over a buffer in one
+ * JS-to-native crossing. Thanks to the resolve hook the kernels cost nothing
+ * unless a script actually touches them. */
+
+namespace hashkernels {
+
+/* Portable CRC-32C (Castagnoli polynomial, reversed 0x82f63b78). Used when
+ * the CPU has no crc32 instructions, and as the dispatch fallback. */
+static uint32_t Crc32cPortable(uint32_t crc, const uint8_t* data,
+                               size_t length) {
+  static uint32_t table[256];
+  static bool initialized = false;
+  if (!initialized) {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) c = (c >> 1) ^ (0x82f63b78 & (0u - (c & 1)));
+      table[i] = c;
+    }
+    initialized = true;
+  }
+
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++) {
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+#ifdef HAVE_X86_CRC32C
+/* Eight bytes per crc32 instruction. The target attribute lets us emit
+ * SSE4.2 here while the rest of the binary stays baseline; the dispatcher
+ * below only takes this path when cpuid says the instructions exist. */
+__attribute__((target("sse4.2"))) static uint32_t Crc32cHardware(
+    uint32_t crc, const uint8_t* data, size_t length) {
+  crc = ~crc;
+  while (length >= 8) {
+    uint64_t chunk;
+    memcpy(&chunk, data, 8);
+    crc = uint32_t(_mm_crc32_u64(crc, chunk));
+    data += 8;
+    length -= 8;
+  }
+  while (length--) {
+    crc = _mm_crc32_u8(crc, *data++);
+  }
+  return ~crc;
+}
+
+static bool HaveHardwareCrc32c(void) {
+  return __builtin_cpu_supports("sse4.2");
+}
+#elif defined(HAVE_ARM_CRC32C)
+static uint32_t Crc32cHardware(uint32_t crc, const uint8_t* data,
+                               size_t length) {
+  crc = ~crc;
+  while (length >= 8) {
+    uint64_t chunk;
+    memcpy(&chunk, data, 8);
+    crc = __crc32cd(crc, chunk);
+    data += 8;
+    length -= 8;
+  }
+  while (length--) {
+    crc = __crc32cb(crc, *data++);
+  }
+  return ~crc;
+}
+
+static bool HaveHardwareCrc32c(void) { return true; }
+#else
+static uint32_t Crc32cHardware(uint32_t crc, const uint8_t* data,
+                               size_t length) {
+  return Crc32cPortable(crc, data, length);
+}
+
+static bool HaveHardwareCrc32c(void) { return false; }
+#endif
+
+/* Runtime-dispatched CRC-32C. Composable: feeding data in chunks gives the
+ * same result as one call over the concatenation. */
+static uint32_t Crc32c(uint32_t crc, const uint8_t* data, size_t length) {
+  static const bool hardware = HaveHardwareCrc32c();
+  return hardware ? Crc32cHardware(crc, data, length)
+                  : Crc32cPortable(crc, data, length);
+}
+
+/* XXH64, one-shot. The stripe loop keeps four independent accumulators with
+ * no cross-lane dependency, which is what lets the compiler vectorize it (or
+ * at least keep all four lanes in flight on a superscalar core). */
+static const uint64_t XXH_PRIME1 = 0x9e3779b185ebca87ULL;
+static const uint64_t XXH_PRIME2 = 0xc2b2ae3d27d4eb4fULL;
+static const uint64_t XXH_PRIME3 = 0x165667b19e3779f9ULL;
+static const uint64_t XXH_PRIME4 = 0x85ebca77c2b2ae63ULL;
+static const uint64_t XXH_PRIME5 = 0x27d4eb2f165667c5ULL;
+
+static uint64_t XxhRotl(uint64_t v, int r) {
+  return (v << r) | (v >> (64 - r));
+}
+
+static uint64_t XxhRead64(const uint8_t* p) {
+  uint64_t v;
+  memcpy(&v, p, 8);
+  return v;
+}
+
+static uint64_t XxhRound(uint64_t acc, uint64_t input) {
+  return XxhRotl(acc + input * XXH_PRIME2, 31) * XXH_PRIME1;
+}
+
+static uint64_t XxhMerge(uint64_t hash, uint64_t acc) {
+  return (hash ^ XxhRound(0, acc)) * XXH_PRIME1 + XXH_PRIME4;
+}
+
+static uint64_t Xxh64(const uint8_t* data, size_t length, uint64_t seed) {
+  const uint8_t* p = data;
+  const uint8_t* end = data + length;
+  uint64_t hash;
+
+  if (length >= 32) {
+    uint64_t v1 = seed + XXH_PRIME1 + XXH_PRIME2;
+    uint64_t v2 = seed + XXH_PRIME2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - XXH_PRIME1;
+
+    do {
+      v1 = XxhRound(v1, XxhRead64(p));
+      v2 = XxhRound(v2, XxhRead64(p + 8));
+      v3 = XxhRound(v3, XxhRead64(p + 16));
+      v4 = XxhRound(v4, XxhRead64(p + 24));
+      p += 32;
+    } while (p + 32 <= end);
+
+    hash = XxhRotl(v1, 1) + XxhRotl(v2, 7) + XxhRotl(v3, 12) +
+           XxhRotl(v4, 18);
+    hash = XxhMerge(hash, v1);
+    hash = XxhMerge(hash, v2);
+    hash = XxhMerge(hash, v3);
+    hash = XxhMerge(hash, v4);
+  } else {
+    hash = seed + XXH_PRIME5;
+  }
+
+  hash += uint64_t(length);
+
+  while (p + 8 <= end) {
+    hash = XxhRotl(hash ^ XxhRound(0, XxhRead64(p)), 27) * XXH_PRIME1 +
+           XXH_PRIME4;
+    p += 8;
+  }
+  if (p + 4 <= end) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    hash = XxhRotl(hash ^ (uint64_t(v) * XXH_PRIME1), 23) * XXH_PRIME2 +
+           XXH_PRIME3;
+    p += 4;
+  }
+  while (p < end) {
+    hash = XxhRotl(hash ^ (*p++ * XXH_PRIME5), 11) * XXH_PRIME1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= XXH_PRIME2;
+  hash ^= hash >> 29;
+  hash *= XXH_PRIME3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+}  // namespace hashkernels
 
 class Crc {
   unsigned long m_crc;
+  uint32_t m_crc32c;
 
-  Crc(void) : m_crc(zlib::crc32(0L, nullptr, 0)) {}
+  Crc(void) : m_crc(zlib::crc32(0L, nullptr, 0)), m_crc32c(0) {}
 
-  bool updateImpl(JSContext* cx, const JS::CallArgs& args) {
-    if (!args.requireAtLeast(cx, "update", 1)) return false;
+  friend class boilerplate::ArenaPool<Crc>;
+
+  // Instance data comes from a slab arena instead of one malloc per object;
+  // the finalizer below pushes the block back on the arena's freelist.
+  static boilerplate::ArenaPool<Crc>& pool(void) {
+    static boilerplate::ArenaPool<Crc> instance;
+    return instance;
+  }
+
+  // Shared argument check for the hashing methods: the first argument must be
+  // a Uint8Array whose bytes we can pin.
+  static JSObject* requireUint8Array(JSContext* cx, const JS::CallArgs& args,
+                                     const char* method) {
+    if (!args.requireAtLeast(cx, method, 1)) return nullptr;
 
     if (!args[0].isObject() || !JS_IsUint8Array(&args[0].toObject())) {
-      JS_ReportErrorASCII(cx, "argument to update() should be a Uint8Array");
-      return false;
+      JS_ReportErrorASCII(cx, "argument to %s() should be a Uint8Array",
+                          method);
+      return nullptr;
     }
 
-    JSObject* buffer = &args[0].toObject();
+    return &args[0].toObject();
+  }
+
+  bool updateImpl(JSContext* cx, const JS::CallArgs& args) {
+    JSObject* buffer = requireUint8Array(cx, args, "update");
+    if (!buffer) return false;
 
     size_t len = JS_GetTypedArrayLength(buffer);
     if (len > std::numeric_limits<unsigned>::max()) {
@@ -60,6 +262,58 @@ class Crc {
     return true;
   }
 
+  // Like update(), but feeds the CRC-32C state through the hardware kernel,
+  // eight bytes per instruction where the CPU supports it.
+  bool update64Impl(JSContext* cx, const JS::CallArgs& args) {
+    JSObject* buffer = requireUint8Array(cx, args, "update64");
+    if (!buffer) return false;
+
+    size_t len = JS_GetTypedArrayLength(buffer);
+
+    {
+      bool isSharedMemory;
+      JS::AutoAssertNoGC nogc;
+      uint8_t* data = JS_GetUint8ArrayData(buffer, &isSharedMemory, nogc);
+
+      m_crc32c = hashkernels::Crc32c(m_crc32c, data, len);
+    }
+
+    args.rval().setUndefined();
+    return true;
+  }
+
+  bool getCrc32cImpl(JSContext* cx, const JS::CallArgs& args) {
+    args.rval().setNumber(m_crc32c);
+    return true;
+  }
+
+  // One-shot XXH64 over the whole buffer: a single JS-to-native crossing, the
+  // result returned as a 16-digit hex string since a JS number can't hold all
+  // 64 bits.
+  bool xxhashImpl(JSContext* cx, const JS::CallArgs& args) {
+    JSObject* buffer = requireUint8Array(cx, args, "xxhash");
+    if (!buffer) return false;
+
+    size_t len = JS_GetTypedArrayLength(buffer);
+    uint64_t hash;
+
+    {
+      bool isSharedMemory;
+      JS::AutoAssertNoGC nogc;
+      uint8_t* data = JS_GetUint8ArrayData(buffer, &isSharedMemory, nogc);
+
+      hash = hashkernels::Xxh64(data, len, 0);
+    }
+
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+    JSString* str = JS_NewStringCopyZ(cx, hex);
+    if (!str) return false;
+
+    args.rval().setString(str);
+    return true;
+  }
+
   bool getChecksumImpl(JSContext* cx, const JS::CallArgs& args) {
     args.rval().setNumber(uint32_t(m_crc));
     return true;
@@ -91,7 +345,11 @@ class Crc {
                             JS_NewObjectForConstructor(cx, &Crc::klass, args));
     if (!newObj) return false;
 
-    Crc* priv = new Crc();
+    Crc* priv = pool().New();
+    if (!priv) {
+      JS_ReportOutOfMemory(cx);
+      return false;
+    }
     JS::SetPrivate(newObj, priv);
 
     args.rval().setObject(*newObj);
@@ -114,6 +372,47 @@ class Crc {
     return getPriv(thisObj)->getChecksumImpl(cx, args);
   }
 
+  static bool update64(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    JS::RootedObject thisObj(cx);
+    if (!args.computeThis(cx, &thisObj)) return false;
+    if (!checkIsInstance(cx, thisObj, "call update64()")) return false;
+    return getPriv(thisObj)->update64Impl(cx, args);
+  }
+
+  static bool getCrc32c(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    JS::RootedObject thisObj(cx);
+    if (!args.computeThis(cx, &thisObj)) return false;
+    if (!checkIsInstance(cx, thisObj, "read crc32c")) return false;
+    return getPriv(thisObj)->getCrc32cImpl(cx, args);
+  }
+
+  static bool xxhash(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    JS::RootedObject thisObj(cx);
+    if (!args.computeThis(cx, &thisObj)) return false;
+    if (!checkIsInstance(cx, thisObj, "call xxhash()")) return false;
+    return getPriv(thisObj)->xxhashImpl(cx, args);
+  }
+
+  // The lazily-resolved prototype properties. An entry is either a method
+  // (JS_DefineFunctionById) or a getter (JS_DefinePropertyById).
+  struct LazyProperty {
+    const char* name;
+    JSNative method;
+    JSNative getter;
+    unsigned nargs;
+  };
+
+  static constexpr LazyProperty lazyProperties[] = {
+      {"update", &Crc::update, nullptr, 1},
+      {"checksum", nullptr, &Crc::getChecksum, 0},
+      {"update64", &Crc::update64, nullptr, 1},
+      {"crc32c", nullptr, &Crc::getCrc32c, 0},
+      {"xxhash", &Crc::xxhash, nullptr, 1},
+  };
+
   static bool newEnumerate(JSContext* cx, JS::HandleObject obj,
                            JS::MutableHandleIdVector properties,
                            bool enumerableOnly) {
@@ -122,13 +421,11 @@ class Crc {
     // prototype.
     if (!isPrototype(obj)) return true;
 
-    jsid idUpdate =
-        JS::PropertyKey::fromPinnedString(JS_AtomizeAndPinString(cx, "update"));
-    if (!properties.append(idUpdate)) return false;
-
-    jsid idChecksum = JS::PropertyKey::fromPinnedString(
-        JS_AtomizeAndPinString(cx, "checksum"));
-    if (!properties.append(idChecksum)) return false;
+    for (const LazyProperty& prop : lazyProperties) {
+      jsid id = JS::PropertyKey::fromPinnedString(
+          JS_AtomizeAndPinString(cx, prop.name));
+      if (!properties.append(id)) return false;
+    }
 
     return true;
   }
@@ -149,18 +446,18 @@ class Crc {
 
     JSLinearString* str = JSID_TO_LINEAR_STRING(id);
 
-    if (JS_LinearStringEqualsAscii(str, "update")) {
-      if (!JS_DefineFunctionById(cx, obj, id, &Crc::update, 1,
-                                 JSPROP_ENUMERATE))
-        return false;
-      *resolved = true;
-      return true;
-    }
-
-    if (JS_LinearStringEqualsAscii(str, "checksum")) {
-      if (!JS_DefinePropertyById(cx, obj, id, &Crc::getChecksum, nullptr,
-                                 JSPROP_ENUMERATE))
-        return false;
+    for (const LazyProperty& prop : lazyProperties) {
+      if (!JS_LinearStringEqualsAscii(str, prop.name)) continue;
+
+      if (prop.method) {
+        if (!JS_DefineFunctionById(cx, obj, id, prop.method, prop.nargs,
+                                   JSPROP_ENUMERATE))
+          return false;
+      } else {
+        if (!JS_DefinePropertyById(cx, obj, id, prop.getter, nullptr,
+                                   JSPROP_ENUMERATE))
+          return false;
+      }
       *resolved = true;
       return true;
     }
@@ -174,14 +471,16 @@ class Crc {
     if (!JSID_IS_STRING(id)) return false;
 
     JSLinearString* str = JSID_TO_LINEAR_STRING(id);
-    return JS_LinearStringEqualsAscii(str, "update") ||
-           JS_LinearStringEqualsAscii(str, "checksum");
+    for (const LazyProperty& prop : lazyProperties) {
+      if (JS_LinearStringEqualsAscii(str, prop.name)) return true;
+    }
+    return false;
   }
 
   static void finalize(JSFreeOp* fop, JSObject* obj) {
     Crc* priv = getPriv(obj);
     if (priv) {
-      delete priv;
+      pool().Delete(priv);
       JS::SetPrivate(obj, nullptr);
     }
   }
@@ -233,10 +532,14 @@ class Crc {
 };
 constexpr JSClassOps Crc::classOps;
 constexpr JSClass Crc::klass;
+constexpr Crc::LazyProperty Crc::lazyProperties[];
 
 static const char* testProgram = R"js(
   const crc = new Crc();
   crc.update(new Uint8Array([1, 2, 3, 4, 5]));
+  crc.update64(new Uint8Array([1, 2, 3, 4, 5, 6, 7, 8, 9]));
+  crc.crc32c;
+  crc.xxhash(new Uint8Array([1, 2, 3, 4, 5]));
   crc.checksum;
 )js";
 
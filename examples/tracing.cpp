@@ -3,12 +3,16 @@
 
 #include <jsapi.h>
 
+#include <js/GCVector.h>
+#include <js/SweepingAPI.h>
+
 #include "boilerplate.h"
 
 // This example illustrates how to safely store GC pointers in the embedding's
 // data structures by implementing appropriate tracing mechanisms. This example
-// covers using strong references where C++ keeps the JS objects alive. Weak
-// references use a different implementation strategy that is not covered here.
+// covers using strong references where C++ keeps the JS objects alive, and
+// weak references where the GC is allowed to reclaim the referent and the
+// embedding's entry is swept away afterwards (see the WeakBox section below).
 
 ////////////////////////////////////////////////////////////
 
@@ -87,6 +91,88 @@ static bool ExistingTypeExample(JSContext* cx) {
 
 ////////////////////////////////////////////////////////////
 
+// The references above are strong: a cache built out of SafeBoxes keeps its
+// entries alive forever, which for a cache is a leak. A weak reference does
+// the opposite -- it never keeps the referent alive, and the entry is swept
+// out of the container once the referent dies.
+//
+// The hook for this is the GCPolicy::needsSweep method that the
+// std::shared_ptr policy above forwards but never exercises. A container
+// registered through JS::WeakCache is visited during the sweep phase of
+// every GC; entries whose policy reports needsSweep are removed. For a
+// JS::Heap edge, needsSweep doubles as the pointer-update step of a moving
+// GC, so a surviving entry's pointer is always current afterwards.
+
+// An example C++ type holding a weak reference to a JS object, keyed by an
+// embedder-side value so swept entries can be identified.
+struct WeakBox {
+  uint32_t key = 0;
+  JS::Heap<JSObject*> weakRef;
+
+  WeakBox(void) = default;
+  WeakBox(uint32_t key, JSObject* obj) : key(key), weakRef(obj) {}
+};
+
+// Sweep instrumentation: how many entries each GC reclaimed, and an optional
+// callback fired per swept entry (e.g. to drop the C++ side of the cache
+// entry).
+static size_t weakEntriesSweptTotal = 0;
+static void (*weakSweepCallback)(uint32_t key) = nullptr;
+
+template <>
+struct JS::GCPolicy<WeakBox> {
+  // Weak means: contribute nothing during marking. (A strong policy would
+  // trace weakRef here, and that one edge is the entire difference.)
+  static void trace(JSTracer* trc, WeakBox* box, const char* name) {}
+
+  static bool needsSweep(WeakBox* box) {
+    if (!box->weakRef) return false;
+    if (!GCPolicy<JS::Heap<JSObject*>>::needsSweep(&box->weakRef))
+      return false;
+
+    weakEntriesSweptTotal++;
+    if (weakSweepCallback) weakSweepCallback(box->key);
+    return true;
+  }
+
+  static bool isValid(const WeakBox& box) { return true; }
+};
+
+static size_t callbackSweptKeys = 0;
+
+static void CountSweptKey(uint32_t key) { callbackSweptKeys++; }
+
+static bool WeakCacheExample(JSContext* cx) {
+  // A JS::WeakCache registers its container with the GC for sweeping; the
+  // GCVector's entries are then at the mercy of the WeakBox policy above.
+  JS::WeakCache<JS::GCVector<WeakBox, 0, js::SystemAllocPolicy>> cache(
+      JS_GetRuntime(cx));
+
+  weakSweepCallback = CountSweptKey;
+
+  // One entry whose referent we keep alive, one whose referent immediately
+  // becomes garbage. Only the Rooted below makes the first object reachable;
+  // the cache itself holds neither alive.
+  JS::RootedObject liveObj(cx, JS_NewPlainObject(cx));
+  if (!liveObj) return false;
+  if (!cache.get().append(WeakBox(1, liveObj))) return false;
+
+  JSObject* doomed = JS_NewPlainObject(cx);
+  if (!doomed) return false;
+  if (!cache.get().append(WeakBox(2, doomed))) return false;
+  doomed = nullptr;  // no root refers to it now
+
+  // A full GC sweeps the cache: entry 2's referent is dead, so the entry is
+  // removed (and the sweep callback sees key 2); entry 1 survives with its
+  // pointer updated if the object moved.
+  JS_GC(cx);
+
+  weakSweepCallback = nullptr;
+  return true;
+}
+
+////////////////////////////////////////////////////////////
+
 // When an embedding wishes to keep GC things alive when the JavaScript no
 // longer has direct references, it must provide GC roots for the various
 // tracing mechanisms to search from. This is done using the PersistentRooted
@@ -151,6 +237,9 @@ static bool TracingExample(JSContext* cx) {
   if (!ExistingTypeExample(cx)) {
     return false;
   }
+  if (!WeakCacheExample(cx)) {
+    return false;
+  }
   if (!GlobalRootExample(cx)) {
     return false;
   }